@@ -1,8 +1,10 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
+import esphome.final_validate as fv
 import voluptuous as vol
 from esphome import automation, pins
 from esphome.const import CONF_ID, CONF_TRIGGER_ID
+from esphome.core import CORE
 
 DEPENDENCIES = ["preferences"]
 MULTI_CONF = True
@@ -13,6 +15,9 @@ RATGDO = ratgdo_ns.class_("RATGDOComponent", cg.Component)
 
 
 SyncFailed = ratgdo_ns.class_("SyncFailed", automation.Trigger.template())
+DoorMotion = ratgdo_ns.class_(
+    "DoorMotion", automation.Trigger.template(cg.float_, cg.int_, cg.uint32)
+)
 
 CONF_OUTPUT_GDO = "output_gdo_pin"
 DEFAULT_OUTPUT_GDO = (
@@ -25,17 +30,40 @@ DEFAULT_INPUT_GDO = (
 CONF_INPUT_OBST = "input_obst_pin"
 DEFAULT_INPUT_OBST = "D7"  # D7 black obstruction sensor terminal
 
+CONF_OBSTRUCTION_INPUT = "obstruction_input"
+OBSTRUCTION_INPUT_ISR = "isr"
+OBSTRUCTION_INPUT_PCNT = "pcnt"
+
 CONF_RATGDO_ID = "ratgdo_id"
 
 CONF_ON_SYNC_FAILED = "on_sync_failed"
+CONF_ON_DOOR_MOTION = "on_door_motion"
+
+CONF_POSITION_MIN_DELTA = "position_min_delta"
+CONF_POSITION_UPDATE_INTERVAL = "position_update_interval"
 
 CONF_PROTOCOL = "protocol"
 
+CONF_PROFILE = "profile"
+
 PROTOCOL_SECPLUSV1 = "secplusv1"
 PROTOCOL_SECPLUSV2 = "secplusv2"
 PROTOCOL_DRYCONTACT = "drycontact"
 SUPPORTED_PROTOCOLS = [PROTOCOL_SECPLUSV1, PROTOCOL_SECPLUSV2, PROTOCOL_DRYCONTACT]
 
+
+def validate_obstruction_input(value):
+    value = cv.one_of(OBSTRUCTION_INPUT_ISR, OBSTRUCTION_INPUT_PCNT, lower=True)(value)
+    if value == OBSTRUCTION_INPUT_PCNT:
+        if not CORE.is_esp32:
+            raise cv.Invalid("The pulse counter is only available on ESP32")
+        from esphome.components.esp32 import VARIANT_ESP32C3, get_esp32_variant
+
+        if get_esp32_variant() == VARIANT_ESP32C3:
+            raise cv.Invalid("The ESP32-C3 has no pulse counter")
+    return value
+
+
 CONFIG_SCHEMA = cv.Schema(
     {
         cv.GenerateID(): cv.declare_id(RATGDO),
@@ -48,17 +76,62 @@ CONFIG_SCHEMA = cv.Schema(
         cv.Optional(CONF_INPUT_OBST, default=DEFAULT_INPUT_OBST): cv.Any(
             cv.none, pins.gpio_input_pin_schema
         ),
+        cv.Optional(
+            CONF_OBSTRUCTION_INPUT, default=OBSTRUCTION_INPUT_ISR
+        ): validate_obstruction_input,
         cv.Optional(CONF_ON_SYNC_FAILED): automation.validate_automation(
             {
                 cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(SyncFailed),
             }
         ),
+        cv.Optional(CONF_ON_DOOR_MOTION): automation.validate_automation(
+            {
+                cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(DoorMotion),
+            }
+        ),
+        cv.Optional(CONF_POSITION_MIN_DELTA, default="1%"): cv.percentage,
+        cv.Optional(
+            CONF_POSITION_UPDATE_INTERVAL, default="500ms"
+        ): cv.positive_time_period_milliseconds,
         cv.Optional(CONF_PROTOCOL, default=PROTOCOL_SECPLUSV2): vol.In(
             SUPPORTED_PROTOCOLS
         ),
+        cv.Optional(CONF_PROFILE, default=False): cv.boolean,
     }
 ).extend(cv.COMPONENT_SCHEMA)
 
+
+# outputs that drive their pin from the ESP8266's timer1
+ESP8266_TIMER1_OUTPUTS = ["esp8266_pwm", "ac_dimmer"]
+
+
+def _final_validate(config):
+    full_config = fv.full_config.get()
+    # the obstruction input is picked at compile time, for every instance
+    inputs = {
+        conf[CONF_OBSTRUCTION_INPUT]
+        for conf in full_config["ratgdo"]
+        if conf.get(CONF_INPUT_OBST)
+    }
+    if len(inputs) > 1:
+        raise cv.Invalid(
+            f"All ratgdo instances must use the same {CONF_OBSTRUCTION_INPUT}",
+            path=[CONF_OBSTRUCTION_INPUT],
+        )
+    # Security+ 1.0 sends from timer1 on the ESP8266
+    if CORE.is_esp8266 and config[CONF_PROTOCOL] == PROTOCOL_SECPLUSV1:
+        for output in full_config.get("output", []):
+            if output.get("platform") in ESP8266_TIMER1_OUTPUTS:
+                raise cv.Invalid(
+                    f"The {output['platform']} output needs timer1, which the "
+                    f"{PROTOCOL_SECPLUSV1} protocol uses on the ESP8266",
+                    path=[CONF_PROTOCOL],
+                )
+    return config
+
+
+FINAL_VALIDATE_SCHEMA = _final_validate
+
 RATGDO_CLIENT_SCHMEA = cv.Schema(
     {
         cv.Required(CONF_RATGDO_ID): cv.use_id(RATGDO),
@@ -81,11 +154,26 @@ async def to_code(config):
     if CONF_INPUT_OBST in config and config[CONF_INPUT_OBST]:
         pin = await cg.gpio_pin_expression(config[CONF_INPUT_OBST])
         cg.add(var.set_input_obst_pin(pin))
+        if config[CONF_OBSTRUCTION_INPUT] == OBSTRUCTION_INPUT_PCNT:
+            cg.add_define("RATGDO_OBSTRUCTION_PCNT")
 
     for conf in config.get(CONF_ON_SYNC_FAILED, []):
         trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
         await automation.build_automation(trigger, [], conf)
 
+    for conf in config.get(CONF_ON_DOOR_MOTION, []):
+        trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], var)
+        await automation.build_automation(
+            trigger,
+            [(cg.float_, "position"), (cg.int_, "direction"), (cg.uint32, "duration")],
+            conf,
+        )
+
+    cg.add(var.set_position_min_delta(config[CONF_POSITION_MIN_DELTA]))
+    cg.add(
+        var.set_position_update_interval(config[CONF_POSITION_UPDATE_INTERVAL])
+    )
+
     cg.add_library(
         name="secplus",
         repository="https://github.com/ratgdo/secplus#f98c3220356c27717a25102c0b35815ebbd26ccc",
@@ -103,4 +191,6 @@ async def to_code(config):
         cg.add_define("PROTOCOL_SECPLUSV2")
     elif config[CONF_PROTOCOL] == PROTOCOL_DRYCONTACT:
         cg.add_define("PROTOCOL_DRYCONTACT")
-    cg.add(var.init_protocol())
+
+    if config[CONF_PROFILE]:
+        cg.add_define("RATGDO_PROFILE")
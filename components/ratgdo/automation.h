@@ -19,5 +19,18 @@ namespace ratgdo {
         }
     };
 
+    // fires when the door starts moving with where it started, the direction
+    // (1 opening, -1 closing) and the expected ms to the limit, and once
+    // more with direction 0 when it stops
+    class DoorMotion : public Trigger<float, int, uint32_t> {
+    public:
+        explicit DoorMotion(RATGDOComponent* parent)
+        {
+            parent->subscribe_door_movement([this](DoorMovement movement) {
+                this->trigger(movement.position, movement.direction, movement.duration);
+            });
+        }
+    };
+
 }
 }
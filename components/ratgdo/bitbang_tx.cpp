@@ -0,0 +1,139 @@
+#include "bitbang_tx.h"
+
+#include "esphome/core/log.h"
+
+#if defined(USE_ESP8266)
+#include <Arduino.h>
+#endif
+
+namespace esphome {
+namespace ratgdo {
+
+    static const char* const TAG = "ratgdo_tx";
+
+#if defined(USE_ESP8266)
+    BitBangTx* BitBangTx::timer1_owner_ = nullptr;
+    // timer1 counts the 80MHz APB clock divided by 16, whatever the CPU runs at
+    static const uint32_t TIMER1_HZ = 80000000 / 16;
+#endif
+
+    bool BitBangTx::setup(InternalGPIOPin* pin, uint32_t baud, bool inverted)
+    {
+        this->pin_ = pin->to_isr();
+        this->inverted_ = inverted;
+        this->bit_time_ = 1000000 / baud;
+
+#if defined(USE_ESP32)
+        esp_timer_create_args_t args {};
+        args.callback = &BitBangTx::timer_callback;
+        args.arg = this;
+        args.name = "ratgdo_tx";
+        this->available_ = esp_timer_create(&args, &this->timer_) == ESP_OK;
+#elif defined(USE_ESP8266)
+        if (timer1_owner_ == nullptr) {
+            timer1_owner_ = this;
+            this->timer1_ticks_ = TIMER1_HZ / baud;
+            timer1_isr_init();
+            timer1_attachInterrupt(&BitBangTx::timer1_isr);
+            this->available_ = true;
+        }
+#endif
+        if (!this->available_) {
+            ESP_LOGW(TAG, "No timer for transmitting, writes will block");
+        }
+        return this->available_;
+    }
+
+    // bit 0 first: start, data LSB first, even parity, stop
+    uint16_t BitBangTx::frame(uint8_t byte)
+    {
+        uint8_t parity = byte;
+        parity ^= parity >> 4;
+        parity ^= parity >> 2;
+        parity ^= parity >> 1;
+        return (static_cast<uint16_t>(byte) << 1) | (static_cast<uint16_t>(parity & 1) << 9) | (1 << 10);
+    }
+
+    bool BitBangTx::write(uint8_t byte)
+    {
+        uint8_t next = (this->head_ + 1) % QUEUE_SIZE;
+        if (next == this->tail_) {
+            return false;
+        }
+        this->queue_[this->head_] = frame(byte);
+        // the timer must not go idle between queueing and checking it
+#if defined(USE_ESP32)
+        portENTER_CRITICAL(&this->lock_);
+#endif
+        this->head_ = next;
+        if (this->bit_ == IDLE) {
+            this->start_timer();
+        }
+#if defined(USE_ESP32)
+        portEXIT_CRITICAL(&this->lock_);
+#endif
+        return true;
+    }
+
+    void BitBangTx::start_timer()
+    {
+        // first tick puts the start bit out
+        this->bit_ = FRAME_BITS;
+#if defined(USE_ESP32)
+        esp_timer_start_periodic(this->timer_, this->bit_time_);
+#elif defined(USE_ESP8266)
+        timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+        timer1_write(this->timer1_ticks_);
+#endif
+    }
+
+    void BitBangTx::stop_timer()
+    {
+#if defined(USE_ESP32)
+        esp_timer_stop(this->timer_);
+#elif defined(USE_ESP8266)
+        timer1_disable();
+#endif
+    }
+
+    void IRAM_ATTR BitBangTx::tick()
+    {
+        if (this->bit_ >= FRAME_BITS) {
+            // the stop bit had its time, start the next frame or go idle
+#if defined(USE_ESP32)
+            portENTER_CRITICAL(&this->lock_);
+#endif
+            bool idle = this->tail_ == this->head_;
+            if (idle) {
+                this->bit_ = IDLE;
+                this->stop_timer();
+            }
+#if defined(USE_ESP32)
+            portEXIT_CRITICAL(&this->lock_);
+#endif
+            if (idle) {
+                return;
+            }
+            this->frame_ = this->queue_[this->tail_];
+            this->tail_ = (this->tail_ + 1) % QUEUE_SIZE;
+            this->bit_ = 0;
+        }
+        bool level = (this->frame_ >> this->bit_) & 1;
+        this->pin_.digital_write(level != this->inverted_);
+        this->bit_ = this->bit_ + 1;
+    }
+
+#if defined(USE_ESP32)
+    void BitBangTx::timer_callback(void* arg)
+    {
+        static_cast<BitBangTx*>(arg)->tick();
+    }
+#elif defined(USE_ESP8266)
+    void IRAM_ATTR BitBangTx::timer1_isr()
+    {
+        timer1_owner_->tick();
+    }
+#endif
+
+} // namespace ratgdo
+} // namespace esphome
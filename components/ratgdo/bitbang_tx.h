@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+#include "esphome/core/gpio.h"
+#include "esphome/core/hal.h"
+
+#if defined(USE_ESP32)
+#include <esp_timer.h>
+#define RATGDO_BITBANG_TX
+#elif defined(USE_ESP8266)
+#define RATGDO_BITBANG_TX
+#endif
+
+namespace esphome {
+namespace ratgdo {
+
+    // Sends 8E1 bytes from a hardware timer, one bit per tick, so a write
+    // returns right away instead of blocking for the whole frame (11 bits,
+    // 9.17ms at 1200 baud). Only built where we have a timer for it,
+    // available() tells the caller to fall back to a blocking write otherwise.
+    //
+    // On the ESP8266 this takes timer1, so there can only be one, and
+    // anything else driven from timer1 breaks: analogWrite(), tone(),
+    // servos, the esp8266_pwm and ac_dimmer outputs. The config rejects
+    // those outputs next to Security+ 1.0.
+    class BitBangTx {
+    public:
+        static const uint8_t QUEUE_SIZE = 8;
+
+        bool setup(InternalGPIOPin* pin, uint32_t baud, bool inverted);
+        bool available() const { return this->available_; }
+
+        // false if the queue is full
+        bool write(uint8_t byte);
+        // a frame is on the wire or queued
+        bool busy() const { return this->bit_ != IDLE || this->head_ != this->tail_; }
+
+    protected:
+        static const uint8_t FRAME_BITS = 11; // start, 8 data, parity, stop
+        static const uint8_t IDLE = 0xff;
+
+        static uint16_t frame(uint8_t byte);
+        void start_timer();
+        void stop_timer();
+        void IRAM_ATTR tick();
+
+#if defined(USE_ESP32)
+        static void timer_callback(void* arg);
+        esp_timer_handle_t timer_ { nullptr };
+        portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+#elif defined(USE_ESP8266)
+        static void IRAM_ATTR timer1_isr();
+        static BitBangTx* timer1_owner_;
+        uint32_t timer1_ticks_ { 0 };
+#endif
+
+        ISRInternalGPIOPin pin_;
+        bool inverted_ { false };
+        bool available_ { false };
+        uint32_t bit_time_ { 0 }; // us
+
+        // written by write(), read by the timer
+        volatile uint16_t queue_[QUEUE_SIZE] {};
+        volatile uint8_t head_ { 0 };
+        volatile uint8_t tail_ { 0 };
+        // owned by the timer while sending
+        volatile uint8_t bit_ { IDLE };
+        uint16_t frame_ { 0 };
+    };
+
+} // namespace ratgdo
+} // namespace esphome
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "esphome/core/gpio.h"
+#include "esphome/core/hal.h"
+
+namespace esphome {
+namespace ratgdo {
+
+    // Remembers when the GDO bus was last seen active, so "has the bus been
+    // idle for X us" is a single subtraction instead of a polling window.
+    //
+    // SoftwareSerial already owns the edge interrupt of the RX pin and a pin
+    // only has one handler, so activity is reported by the protocol instead:
+    // line samples while it waits to transmit, bytes as they are read from
+    // the serial buffer and the end of our own transmissions. Bytes still
+    // sitting in the serial buffer aren't stamped yet, so a transmitter has
+    // to check the buffer too and watch the line for its whole window.
+    class BusMonitor {
+    public:
+        void setup(InternalGPIOPin* rx_pin)
+        {
+            this->rx_pin_ = rx_pin;
+            this->last_activity_ = micros();
+        }
+
+        // Samples the RX line, returns true if somebody is talking right now
+        bool sample()
+        {
+            if (this->rx_pin_->digital_read()) {
+                this->mark_activity();
+                return true;
+            }
+            return false;
+        }
+
+        void mark_activity() { this->last_activity_ = micros(); }
+
+        bool idle_for(uint32_t us) const { return micros() - this->last_activity_ >= us; }
+        uint32_t last_activity() const { return this->last_activity_; }
+
+    protected:
+        InternalGPIOPin* rx_pin_ { nullptr };
+        uint32_t last_activity_ { 0 };
+    };
+
+} // namespace ratgdo
+} // namespace esphome
@@ -1,29 +1,80 @@
 #pragma once
-#include <functional>
 #include <utility>
-#include <vector>
+
+#include "esphome/core/log.h"
+
+#include "inline_function.h"
 
 namespace esphome {
 namespace ratgdo {
 
-    template <typename... X>
-    class OnceCallbacks;
+    // Callbacks live in a fixed number of inline slots. Registering more
+    // than N is logged and add() returns false. How many register often
+    // depends on the YAML (one per entity), which the compiler doesn't see,
+    // so that can't be a static_assert; owners fail loudly instead, or
+    // clear() first where a newer callback replaces the pending one.
 
-    template <typename... Ts>
-    class OnceCallbacks<void(Ts...)> {
+    template <typename Signature, uint8_t N, size_t Size = CALLBACK_SIZE>
+    class Callbacks;
+
+    template <typename... Ts, uint8_t N, size_t Size>
+    class Callbacks<void(Ts...), N, Size> {
     public:
-        template <typename Callback>
-        void operator()(Callback&& callback) { this->callbacks_.push_back(std::forward<Callback>(callback)); }
+        using Callback = InlineFunction<void(Ts...), Size>;
 
-        void trigger(Ts... args)
+        bool add(Callback&& callback)
+        {
+            if (this->count_ == N) {
+                ESP_LOGE("ratgdo", "No room for more than %d callbacks, ignoring", N);
+                return false;
+            }
+            this->callbacks_[this->count_++] = std::move(callback);
+            return true;
+        }
+
+        void clear()
+        {
+            for (uint8_t i = 0; i < this->count_; i++) {
+                this->callbacks_[i].reset();
+            }
+            this->count_ = 0;
+        }
+
+        void call(Ts... args) const
         {
-            for (auto& cb : this->callbacks_)
-                cb(args...);
-            this->callbacks_.clear();
+            for (uint8_t i = 0; i < this->count_; i++) {
+                this->callbacks_[i](args...);
+            }
         }
 
     protected:
-        std::vector<std::function<void(Ts...)>> callbacks_;
+        Callback callbacks_[N];
+        uint8_t count_ { 0 };
+    };
+
+    template <typename Signature, uint8_t N, size_t Size = CALLBACK_SIZE>
+    class OnceCallbacks;
+
+    template <typename... Ts, uint8_t N, size_t Size>
+    class OnceCallbacks<void(Ts...), N, Size> : public Callbacks<void(Ts...), N, Size> {
+    public:
+        using Callback = typename Callbacks<void(Ts...), N, Size>::Callback;
+
+        void operator()(Callback&& callback) { this->add(std::move(callback)); }
+
+        void trigger(Ts... args)
+        {
+            // a callback may register the next one, so take the current ones out first
+            Callback pending[N];
+            uint8_t count = this->count_;
+            for (uint8_t i = 0; i < count; i++) {
+                pending[i] = std::move(this->callbacks_[i]);
+            }
+            this->count_ = 0;
+            for (uint8_t i = 0; i < count; i++) {
+                pending[i](args...);
+            }
+        }
     };
 
 } // namespace ratgdo
@@ -0,0 +1,125 @@
+#include "door_motion.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace esphome {
+namespace ratgdo {
+
+    // weight of a new observation in the running averages
+    static const float LEARN_RATE = 0.3;
+
+    // partial travels are only used to learn the ramp if the end
+    // ramp is at least this much of the travel time
+    static const float MIN_RAMP_SHARE = 0.25;
+
+    static float average(float current, float observed)
+    {
+        return current + LEARN_RATE * (observed - current);
+    }
+
+    // cruise speed in travel per ms
+    float DoorMotionModel::speed(bool opening) const
+    {
+        const auto& p = this->profile(opening);
+        return 1.0f / (p.travel - p.ramp);
+    }
+
+    float DoorMotionModel::distance(bool opening, float elapsed, float limit) const
+    {
+        const auto& p = this->profile(opening);
+        if (elapsed <= 0) {
+            return 0;
+        }
+        auto v = this->speed(opening);
+        auto total = limit / v + p.ramp;
+        if (elapsed >= total) {
+            return limit;
+        }
+        if (p.ramp <= 0 || limit / v < p.ramp) {
+            // no ramp, or too short to ever reach cruise speed
+            return limit * elapsed / total;
+        }
+        if (elapsed < p.ramp) {
+            return 0.5f * v * elapsed * elapsed / p.ramp;
+        }
+        if (elapsed < total - p.ramp) {
+            return v * (elapsed - 0.5f * p.ramp);
+        }
+        auto left = total - elapsed;
+        return limit - 0.5f * v * left * left / p.ramp;
+    }
+
+    float DoorMotionModel::time_to(bool opening, float distance, float limit) const
+    {
+        const auto& p = this->profile(opening);
+        if (distance <= 0) {
+            return 0;
+        }
+        auto v = this->speed(opening);
+        auto total = limit / v + p.ramp;
+        if (distance >= limit) {
+            return total;
+        }
+        if (p.ramp <= 0 || limit / v < p.ramp) {
+            return total * distance / limit;
+        }
+        auto ramp_distance = 0.5f * v * p.ramp;
+        if (distance < ramp_distance) {
+            return std::sqrt(2 * distance * p.ramp / v);
+        }
+        if (distance < limit - ramp_distance) {
+            return distance / v + 0.5f * p.ramp;
+        }
+        return total - std::sqrt(2 * (limit - distance) * p.ramp / v);
+    }
+
+    float DoorMotionModel::stop_distance(bool opening) const
+    {
+        const auto& p = this->profile(opening);
+        if (!this->known(opening)) {
+            return 0;
+        }
+        return this->speed(opening) * std::max(0.0f, p.stop_latency - 0.5f * p.ramp);
+    }
+
+    float DoorMotionModel::learn_travel(bool opening, float limit, uint32_t elapsed)
+    {
+        auto& p = this->profile(opening);
+        if (!this->known(opening)) {
+            if (limit >= 0.99f) {
+                p.travel = elapsed;
+            }
+            return 0;
+        }
+
+        auto predicted = this->time_to(opening, limit, limit);
+        auto error = (elapsed - predicted) / p.travel;
+
+        if (limit >= 0.99f) {
+            p.travel = average(p.travel, elapsed);
+        } else if (limit >= 0.1f && 1 - limit >= MIN_RAMP_SHARE) {
+            // a shorter travel spends a larger share of its time ramping,
+            // the ramp is what explains the difference to the prediction
+            p.ramp = average(p.ramp, p.ramp + (elapsed - predicted) / (1 - limit));
+            p.ramp = std::min(std::max(p.ramp, 0.0f), p.travel / 4);
+        }
+
+        this->error_ = this->error_ < 0 ? std::fabs(error) : average(this->error_, std::fabs(error));
+        return error;
+    }
+
+    void DoorMotionModel::learn_stop_latency(bool opening, uint32_t latency)
+    {
+        auto& p = this->profile(opening);
+        p.stop_latency = p.stop_latency == 0 ? latency : average(p.stop_latency, latency);
+    }
+
+    void DoorMotionModel::learn_start_latency(uint32_t latency)
+    {
+        auto& l = this->profiles_.start_latency;
+        l = l == 0 ? latency : average(l, latency);
+    }
+
+} // namespace ratgdo
+} // namespace esphome
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace ratgdo {
+
+    // What we know about the door moving in one direction, all in ms
+    struct DoorMotionProfile {
+        float travel { 0 }; // full travel from limit to limit, 0 while unknown
+        float ramp { 0 }; // soft start and soft stop, each
+        float stop_latency { 0 }; // from a STOP command to the STOPPED report
+    };
+
+    struct DoorMotionProfiles {
+        DoorMotionProfile opening;
+        DoorMotionProfile closing;
+        float start_latency { 0 }; // from an OPEN/CLOSE command to the door moving, ms
+    };
+
+    // Trapezoidal motion model of the door, refined from every travel we see.
+    //
+    // The door accelerates for `ramp` ms when it starts, moves at a constant
+    // speed and, when it runs into a limit, slows down again for `ramp` ms.
+    // Distances are fractions of the full travel.
+    class DoorMotionModel {
+    public:
+        DoorMotionProfiles& profiles() { return this->profiles_; }
+        const DoorMotionProfile& profile(bool opening) const { return opening ? this->profiles_.opening : this->profiles_.closing; }
+        DoorMotionProfile& profile(bool opening) { return opening ? this->profiles_.opening : this->profiles_.closing; }
+        bool known(bool opening) const { return this->profile(opening).travel > 0; }
+
+        // distance covered `elapsed` ms after starting from rest, `limit` away from the limit
+        float distance(bool opening, float elapsed, float limit) const;
+        // ms needed to cover `distance` from rest, `limit` away from the limit
+        float time_to(bool opening, float distance, float limit) const;
+        // distance the door keeps going after a STOP command at cruise speed
+        float stop_distance(bool opening) const;
+
+        // A travel from `limit` away until the limit took `elapsed` ms. Returns
+        // the prediction error as a fraction of the full travel.
+        float learn_travel(bool opening, float limit, uint32_t elapsed);
+        void learn_stop_latency(bool opening, uint32_t latency);
+        void learn_start_latency(uint32_t latency);
+        float start_latency() const { return this->profiles_.start_latency; }
+
+        // running average of the absolute prediction error, fraction of the full travel
+        float error() const { return this->error_; }
+
+    protected:
+        float speed(bool opening) const;
+
+        DoorMotionProfiles profiles_;
+        float error_ { -1 };
+    };
+
+} // namespace ratgdo
+} // namespace esphome
@@ -22,6 +22,7 @@ namespace ratgdo {
 
         void DryContact::loop()
         {
+            this->timers_.loop();
         }
 
         void DryContact::dump_config()
@@ -53,8 +54,9 @@ namespace ratgdo {
             }
             ESP_LOG1(TAG, "Door action: %s", DoorAction_to_string(action));
 
+            // a toggle while the button is still pressed keeps it pressed for another 200ms
             this->tx_pin_->digital_write(1);
-            this->scheduler_->set_timeout(this->ratgdo_, "", 200, [=] {
+            this->timers_.reset_timeout(this->door_release_timer_, 200, [=] {
                 this->tx_pin_->digital_write(0);
             });
         }
@@ -7,6 +7,7 @@
 #include "observable.h"
 #include "protocol.h"
 #include "ratgdo_state.h"
+#include "timers.h"
 
 namespace esphome {
 
@@ -18,7 +19,7 @@ namespace ratgdo {
 
         using namespace esphome::ratgdo::protocol;
 
-        class DryContact : public Protocol {
+        class DryContact {
         public:
             void setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin);
             void loop();
@@ -37,6 +38,9 @@ namespace ratgdo {
         protected:
             Traits traits_;
 
+            Timers<1> timers_;
+            TimerHandle door_release_timer_;
+
             InternalGPIOPin* tx_pin_;
             InternalGPIOPin* rx_pin_;
 
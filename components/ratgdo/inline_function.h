@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace esphome {
+namespace ratgdo {
+
+    // callables registered on observables and callbacks capture `this` and maybe a value
+    static const size_t CALLBACK_SIZE = 2 * sizeof(void*);
+
+    template <typename Signature, size_t Size = CALLBACK_SIZE>
+    class InlineFunction;
+
+    // Move-only std::function replacement that keeps the callable in Size bytes
+    // of inline storage and never allocates. Callables that don't fit fail to compile.
+    template <typename R, typename... Args, size_t Size>
+    class InlineFunction<R(Args...), Size> {
+    public:
+        InlineFunction() = default;
+        InlineFunction(std::nullptr_t) { }
+
+        template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+        InlineFunction(F&& f)
+        {
+            using Callable = typename std::decay<F>::type;
+            static_assert(sizeof(Callable) <= Size, "callable doesn't fit, capture less or give the use site a bigger Size");
+            static_assert(alignof(Callable) <= alignof(void*), "callable needs more alignment than the inline storage has");
+            new (this->storage_) Callable(std::forward<F>(f));
+            this->invoke_ = [](void* storage, Args... args) -> R {
+                return (*static_cast<Callable*>(storage))(std::forward<Args>(args)...);
+            };
+            // moves src into dst when given one, then destroys src
+            this->manage_ = [](void* dst, void* src) {
+                if (dst != nullptr) {
+                    new (dst) Callable(std::move(*static_cast<Callable*>(src)));
+                }
+                static_cast<Callable*>(src)->~Callable();
+            };
+        }
+
+        InlineFunction(InlineFunction&& other) { this->move_from(other); }
+        InlineFunction& operator=(InlineFunction&& other)
+        {
+            if (this != &other) {
+                this->reset();
+                this->move_from(other);
+            }
+            return *this;
+        }
+        InlineFunction(const InlineFunction&) = delete;
+        InlineFunction& operator=(const InlineFunction&) = delete;
+
+        ~InlineFunction() { this->reset(); }
+
+        void reset()
+        {
+            if (this->manage_ != nullptr) {
+                this->manage_(nullptr, this->storage_);
+                this->invoke_ = nullptr;
+                this->manage_ = nullptr;
+            }
+        }
+
+        explicit operator bool() const { return this->invoke_ != nullptr; }
+
+        R operator()(Args... args) const
+        {
+            return this->invoke_(const_cast<unsigned char*>(this->storage_), std::forward<Args>(args)...);
+        }
+
+    private:
+        void move_from(InlineFunction& other)
+        {
+            if (other.manage_ != nullptr) {
+                other.manage_(this->storage_, other.storage_);
+                this->invoke_ = other.invoke_;
+                this->manage_ = other.manage_;
+                other.invoke_ = nullptr;
+                other.manage_ = nullptr;
+            }
+        }
+
+        alignas(void*) unsigned char storage_[Size];
+        R (*invoke_)(void*, Args...) { nullptr };
+        void (*manage_)(void* dst, void* src) { nullptr };
+    };
+
+} // namespace ratgdo
+} // namespace esphome
@@ -5,9 +5,16 @@
 namespace esphome {
 namespace ratgdo {
 
+    using protocol::GetRollingCodeCounter;
     using protocol::SetClientID;
     using protocol::SetRollingCodeCounter;
 
+    // The rolling code counter is persisted as a reservation: flash holds a value
+    // ROLLING_CODE_RESERVATION ahead of the counter and is only written again when
+    // the counter gets within half a block of it. After a crash the counter resumes
+    // from the reservation, which is never behind a code that was already sent.
+    static const uint32_t ROLLING_CODE_RESERVATION = 60;
+
     float normalize_client_id(float client_id)
     {
         uint32_t int_value = static_cast<uint32_t>(client_id);
@@ -52,6 +59,18 @@ namespace ratgdo {
                 }
             }
         }
+        if (this->number_type_ == RATGDO_ROLLING_CODE_COUNTER) {
+            this->rolling_code_reserved_ = static_cast<uint32_t>(value);
+#ifdef USE_ESP8266
+            // RTC memory still has the exact counter after a soft reset, no need to skip ahead
+            this->rtc_pref_ = global_preferences->make_preference<uint32_t>(this->get_object_id_hash() + 1, false);
+            uint32_t counter;
+            if (this->rtc_pref_.load(&counter)) {
+                ESP_LOGD(TAG, "Restored rolling code counter %" PRIu32 " from RTC memory, reserved up to %" PRIu32, counter, this->rolling_code_reserved_);
+                value = counter;
+            }
+#endif
+        }
         this->control(value);
 
         if (this->number_type_ == RATGDO_ROLLING_CODE_COUNTER) {
@@ -90,10 +109,49 @@ namespace ratgdo {
         if (value == this->state) {
             return;
         }
-        this->pref_.save(&value);
+        if (this->number_type_ == RATGDO_ROLLING_CODE_COUNTER) {
+            this->save_rolling_code_counter(static_cast<uint32_t>(value));
+        } else {
+            this->pref_.save(&value);
+        }
         this->publish_state(value);
     }
 
+    void RATGDONumber::save_rolling_code_counter(uint32_t counter)
+    {
+#ifdef USE_ESP8266
+        this->rtc_pref_.save(&counter);
+#endif
+        // updates reach us deferred, so reserve the next block while half of the current one is left
+        if (counter + ROLLING_CODE_RESERVATION / 2 > this->rolling_code_reserved_ || counter + ROLLING_CODE_RESERVATION < this->rolling_code_reserved_) {
+            this->rolling_code_reserved_ = counter + ROLLING_CODE_RESERVATION;
+            float reserved = this->rolling_code_reserved_;
+            ESP_LOGD(TAG, "Reserving rolling codes up to %" PRIu32, this->rolling_code_reserved_);
+            this->pref_.save(&reserved);
+            // don't wait for the next flash_write_interval, the reservation must be on flash before we use it
+            global_preferences->sync();
+        }
+    }
+
+    void RATGDONumber::on_shutdown()
+    {
+        if (this->number_type_ != RATGDO_ROLLING_CODE_COUNTER) {
+            return;
+        }
+        // clean shutdown (reboot, OTA), store the exact counter so nothing is skipped on the next boot
+        auto result = this->parent_->call_protocol(GetRollingCodeCounter {});
+        if (result.tag != protocol::Result::Tag::rolling_code_counter) {
+            return;
+        }
+        uint32_t counter = **result.value.rolling_code_counter.value;
+        float value = counter;
+        this->pref_.save(&value);
+#ifdef USE_ESP8266
+        this->rtc_pref_.save(&counter);
+#endif
+        global_preferences->sync();
+    }
+
     void RATGDONumber::control(float value)
     {
         if (this->number_type_ == RATGDO_ROLLING_CODE_COUNTER) {
@@ -19,6 +19,7 @@ namespace ratgdo {
     public:
         void dump_config() override;
         void setup() override;
+        void on_shutdown() override;
         void set_number_type(NumberType number_type);
         // other esphome components that persist state in the flash have HARDWARE priority
         // ensure we get initialized before them, so that the state doesn't get invalidated
@@ -29,8 +30,14 @@ namespace ratgdo {
         void control(float value) override;
 
     protected:
+        void save_rolling_code_counter(uint32_t counter);
+
         NumberType number_type_;
         ESPPreferenceObject pref_;
+        uint32_t rolling_code_reserved_ { 0 }; // persisted upper bound of used rolling codes
+#ifdef USE_ESP8266
+        ESPPreferenceObject rtc_pref_; // exact rolling code counter, survives soft resets
+#endif
     };
 
 } // namespace ratgdo
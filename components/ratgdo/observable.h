@@ -1,14 +1,18 @@
 #pragma once
-#include <functional>
 #include <utility>
-#include <vector>
+
+#include "callbacks.h"
 
 namespace esphome {
 namespace ratgdo {
 
-    template <typename T>
+    // Observers only see the latest value, delivered by flush(). N is the
+    // number of observers, one entity per config entry is the usual case.
+    template <typename T, uint8_t N = 2>
     class observable {
     public:
+        using Observer = typename Callbacks<void(T), N>::Callback;
+
         observable(const T& value)
             : value_(value)
         {
@@ -19,7 +23,7 @@ namespace ratgdo {
         {
             if (value != this->value_) {
                 this->value_ = value;
-                this->notify();
+                this->changed_ = true;
             }
             return *this;
         }
@@ -27,22 +31,28 @@ namespace ratgdo {
         T const* operator&() const { return &this->value_; }
         T const& operator*() const { return this->value_; }
 
-        template <typename Observer>
-        void subscribe(Observer&& observer)
+        // false when all N slots are taken
+        bool subscribe(Observer&& observer) { return this->observers_.add(std::move(observer)); }
+
+        // returns whether the value changed since the last call
+        bool take_changed()
         {
-            this->observers_.push_back(std::forward<Observer>(observer));
+            bool changed = this->changed_;
+            this->changed_ = false;
+            return changed;
         }
 
-        void notify() const
+        void flush()
         {
-            for (const auto& observer : this->observers_) {
-                observer(this->value_);
+            if (this->take_changed()) {
+                this->observers_.call(this->value_);
             }
         }
 
     private:
         T value_;
-        std::vector<std::function<void(T)>> observers_;
+        bool changed_ { false };
+        Callbacks<void(T), N> observers_;
     };
 
 } // namespace ratgdo
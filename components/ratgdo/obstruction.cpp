@@ -0,0 +1,168 @@
+#include "obstruction.h"
+#include "esphome/core/log.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace esphome {
+namespace ratgdo {
+
+    // edges in a row, each on time, before the sensor counts as clear
+    static const uint8_t PULSES_TO_CLEAR = 3;
+
+    // a pulse is overdue after this many periods, within the bounds below;
+    // the lower bound also gives the line time to drop when the sensor
+    // falls asleep, so that doesn't read as an obstruction
+    static const float OVERDUE_PERIODS = 2.5;
+    static const uint32_t MIN_OVERDUE = 20000; // us
+    static const uint32_t MAX_OVERDUE = 50000;
+    static const float NOMINAL_PERIOD = 7000;
+
+    // the line is high without pulses for a while when the sensor wakes up
+    static const uint32_t WAKE_GUARD = 700000;
+
+    static const uint32_t STATS_WINDOW = 1000000;
+    static const float PERIOD_LEARN_RATE = 0.1;
+
+    void IsrObstructionInput::setup(InternalGPIOPin* pin)
+    {
+        this->pin_ = pin;
+        this->pin_->setup();
+        this->pin_->pin_mode(gpio::FLAG_INPUT);
+        this->pin_->attach_interrupt(ObstructionStore::isr, &this->store_, gpio::INTERRUPT_FALLING_EDGE);
+    }
+
+#ifdef RATGDO_OBSTRUCTION_PCNT
+    static const char* const TAG = "ratgdo_obstruction";
+
+    // the counter wraps to 0 when it reaches this
+    static const int16_t PCNT_LIMIT = INT16_MAX;
+    // ignore glitches shorter than this many APB cycles (80MHz), the max
+    static const uint16_t PCNT_FILTER = 1023;
+
+    static uint8_t next_pcnt_unit = 0;
+
+    void PcntObstructionInput::setup(InternalGPIOPin* pin)
+    {
+        if (next_pcnt_unit >= PCNT_UNIT_MAX) {
+            ESP_LOGW(TAG, "No pulse counter unit left, counting obstruction pulses with an interrupt");
+            IsrObstructionInput::setup(pin);
+            return;
+        }
+        this->pin_ = pin;
+        this->pin_->setup();
+        this->pin_->pin_mode(gpio::FLAG_INPUT);
+        this->unit_ = static_cast<pcnt_unit_t>(next_pcnt_unit++);
+
+        pcnt_config_t config {};
+        config.pulse_gpio_num = pin->get_pin();
+        config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+        config.lctrl_mode = PCNT_MODE_KEEP;
+        config.hctrl_mode = PCNT_MODE_KEEP;
+        config.pos_mode = PCNT_COUNT_DIS;
+        config.neg_mode = PCNT_COUNT_INC;
+        config.counter_h_lim = PCNT_LIMIT;
+        config.counter_l_lim = 0;
+        config.unit = this->unit_;
+        config.channel = PCNT_CHANNEL_0;
+        if (pcnt_unit_config(&config) != ESP_OK
+            || pcnt_set_filter_value(this->unit_, PCNT_FILTER) != ESP_OK
+            || pcnt_filter_enable(this->unit_) != ESP_OK
+            || pcnt_counter_clear(this->unit_) != ESP_OK
+            || pcnt_counter_resume(this->unit_) != ESP_OK) {
+            ESP_LOGW(TAG, "Pulse counter setup failed, counting obstruction pulses with an interrupt");
+            IsrObstructionInput::setup(pin);
+            return;
+        }
+        this->counting_ = true;
+    }
+
+    ObstructionPulses PcntObstructionInput::take()
+    {
+        if (!this->counting_) {
+            return IsrObstructionInput::take();
+        }
+        int16_t count;
+        if (pcnt_get_counter_value(this->unit_, &count) != ESP_OK) {
+            return {};
+        }
+        ObstructionPulses pulses;
+        pulses.count = count >= this->last_count_ ? count - this->last_count_ : count + PCNT_LIMIT - this->last_count_;
+        if (pulses.count != 0) {
+            pulses.last_edge = micros();
+        }
+        this->last_count_ = count;
+        return pulses;
+    }
+#endif
+
+    uint32_t ObstructionDetector::overdue_after() const
+    {
+        auto period = this->period_ > 0 ? this->period_ : NOMINAL_PERIOD;
+        return std::min(std::max(static_cast<uint32_t>(period * OVERDUE_PERIODS), MIN_OVERDUE), MAX_OVERDUE);
+    }
+
+    ObstructionState ObstructionDetector::update(const ObstructionPulses& pulses, bool line_high, uint32_t now)
+    {
+        if (pulses.count > 0) {
+            bool on_time = this->seen_edge_ && pulses.last_edge - this->last_edge_ <= pulses.count * this->overdue_after();
+            if (on_time) {
+                float interval = static_cast<float>(pulses.last_edge - this->last_edge_) / pulses.count;
+                this->period_ = this->period_ == 0 ? interval : this->period_ + PERIOD_LEARN_RATE * (interval - this->period_);
+            }
+            this->streak_ = std::min<uint32_t>((on_time ? this->streak_ : 0) + pulses.count, UINT8_MAX);
+            this->seen_edge_ = true;
+            this->last_edge_ = pulses.last_edge;
+            if (this->streak_ >= PULSES_TO_CLEAR) {
+                this->state_ = ObstructionState::CLEAR;
+            }
+        } else if (!this->seen_edge_ || now - this->last_edge_ > this->overdue_after()) {
+            this->seen_edge_ = false;
+            this->streak_ = 0;
+            if (!line_high) {
+                // asleep
+                this->asleep_recently_ = true;
+                this->asleep_at_ = now;
+            } else if (this->asleep_recently_ && now - this->asleep_at_ <= WAKE_GUARD) {
+                // waking up
+            } else {
+                this->asleep_recently_ = false;
+                this->state_ = ObstructionState::OBSTRUCTED;
+            }
+        }
+
+        this->update_stats(pulses, now);
+        return this->state_;
+    }
+
+    void ObstructionDetector::update_stats(const ObstructionPulses& pulses, uint32_t now)
+    {
+        this->window_min_ = std::min(this->window_min_, pulses.min_interval);
+        this->window_max_ = std::max(this->window_max_, pulses.max_interval);
+        if (now - this->window_start_ < STATS_WINDOW) {
+            return;
+        }
+        // the pulse counter only counts edges, it has no intervals to
+        // give a spread from, but the period comes from the edge count
+        if (this->period_ > 0) {
+            float jitter = this->window_max_ != 0 ? (this->window_max_ - this->window_min_) / 1000.0f : NAN;
+            this->stats_ = ObstructionStats { this->period_ / 1000, jitter };
+            this->stats_ready_ = true;
+        }
+        this->window_start_ = now;
+        this->window_min_ = UINT32_MAX;
+        this->window_max_ = 0;
+    }
+
+    bool ObstructionDetector::take_stats(ObstructionStats& stats)
+    {
+        if (!this->stats_ready_) {
+            return false;
+        }
+        stats = this->stats_;
+        this->stats_ready_ = false;
+        return true;
+    }
+
+} // namespace ratgdo
+} // namespace esphome
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+
+#include "esphome/core/gpio.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+
+#include "ratgdo_state.h"
+
+#ifdef RATGDO_OBSTRUCTION_PCNT
+#include <driver/pcnt.h>
+#endif
+
+namespace esphome {
+namespace ratgdo {
+
+    // Falling edges of the obstruction input seen since the last read
+    struct ObstructionPulses {
+        uint32_t count { 0 };
+        uint32_t last_edge { 0 }; // micros
+        uint32_t min_interval { UINT32_MAX }; // us, between back-to-back edges
+        uint32_t max_interval { 0 };
+    };
+
+    // Filled from the pin interrupt, read and reset from the loop
+    struct ObstructionStore {
+        // longer gaps are the sensor sleeping or obstructed, not jitter
+        static const uint32_t MAX_PULSE_INTERVAL = 50000;
+
+        volatile uint32_t count { 0 };
+        volatile uint32_t last_edge { 0 };
+        volatile uint32_t min_interval { UINT32_MAX };
+        volatile uint32_t max_interval { 0 };
+
+        static void IRAM_ATTR HOT isr(ObstructionStore* arg)
+        {
+            uint32_t now = micros();
+            uint32_t interval = now - arg->last_edge;
+            if (arg->last_edge != 0 && interval < MAX_PULSE_INTERVAL) {
+                if (interval < arg->min_interval) {
+                    arg->min_interval = interval;
+                }
+                if (interval > arg->max_interval) {
+                    arg->max_interval = interval;
+                }
+            }
+            arg->last_edge = now;
+            arg->count = arg->count + 1;
+        }
+
+        ObstructionPulses take()
+        {
+            InterruptLock lock;
+            ObstructionPulses pulses { this->count, this->last_edge, this->min_interval, this->max_interval };
+            this->count = 0;
+            this->min_interval = UINT32_MAX;
+            this->max_interval = 0;
+            return pulses;
+        }
+    };
+
+    // Where the pulses come from, chosen at compile time like the protocol.
+    // Anything with setup(), take() and line_high() fits; the detector only
+    // sees ObstructionPulses, so it can be fed from a mock on the host.
+    class IsrObstructionInput {
+    public:
+        void setup(InternalGPIOPin* pin);
+        ObstructionPulses take() { return this->store_.take(); }
+        bool line_high() { return this->pin_->digital_read(); }
+
+    protected:
+        InternalGPIOPin* pin_ { nullptr };
+        ObstructionStore store_ {};
+    };
+
+#ifdef RATGDO_OBSTRUCTION_PCNT
+    // Counts the pulses in the ESP32 pulse counter, without an interrupt per
+    // pulse. Edges are stamped when the loop reads the count, so the period
+    // sensor still works but the jitter sensor stays unknown. Falls back to
+    // the interrupt if no counter unit is available.
+    class PcntObstructionInput : public IsrObstructionInput {
+    public:
+        void setup(InternalGPIOPin* pin);
+        ObstructionPulses take();
+
+    protected:
+        pcnt_unit_t unit_ { PCNT_UNIT_0 };
+        int16_t last_count_ { 0 };
+        bool counting_ { false };
+    };
+
+    using ObstructionInput = PcntObstructionInput;
+#else
+    using ObstructionInput = IsrObstructionInput;
+#endif
+
+    // Pulse period and its spread over the last statistics window, ms
+    struct ObstructionStats {
+        float period;
+        float jitter; // NAN when the input doesn't time single edges
+    };
+
+    // The obstruction sensor has 3 states: clear (HIGH with a LOW pulse every
+    // ~7ms), obstructed (HIGH) and asleep (LOW). The line drops slowly when the
+    // sensor falls asleep and is high without pulses for a while when it wakes.
+    //
+    // Every edge is timestamped, so an obstruction shows as soon as a pulse is
+    // overdue, instead of after a fixed window. Pure logic, fed from the loop.
+    class ObstructionDetector {
+    public:
+        // pulses since the last call, the current line level and micros()
+        ObstructionState update(const ObstructionPulses& pulses, bool line_high, uint32_t now);
+        // true once per statistics window, once there is a period
+        bool take_stats(ObstructionStats& stats);
+
+    protected:
+        void update_stats(const ObstructionPulses& pulses, uint32_t now);
+        uint32_t overdue_after() const;
+
+        ObstructionState state_ { ObstructionState::UNKNOWN };
+        bool seen_edge_ { false };
+        uint32_t last_edge_ { 0 };
+        uint8_t streak_ { 0 }; // edges in a row, each on time
+        bool asleep_recently_ { false };
+        uint32_t asleep_at_ { 0 };
+        float period_ { 0 }; // us, running average
+
+        uint32_t window_start_ { 0 };
+        uint32_t window_min_ { UINT32_MAX };
+        uint32_t window_max_ { 0 };
+        bool stats_ready_ { false };
+        ObstructionStats stats_ {};
+    };
+
+} // namespace ratgdo
+} // namespace esphome
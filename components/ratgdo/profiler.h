@@ -0,0 +1,151 @@
+#pragma once
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace esphome {
+namespace ratgdo {
+
+#ifdef RATGDO_PROFILE
+
+    // Timing statistics for one code section, measured in CPU cycles and kept
+    // in fixed memory. p99 comes from a log2 histogram with two buckets per
+    // octave, so it is accurate to within ~40%.
+    class SectionProfile {
+    public:
+        static const uint8_t BUCKETS = 64;
+
+        void record(uint32_t cycles)
+        {
+            this->count_++;
+            this->total_ += cycles;
+            if (cycles < this->min_) {
+                this->min_ = cycles;
+            }
+            if (cycles > this->max_) {
+                this->max_ = cycles;
+            }
+            this->buckets_[bucket(cycles)]++;
+        }
+
+        void reset()
+        {
+            this->count_ = 0;
+            this->total_ = 0;
+            this->min_ = UINT32_MAX;
+            this->max_ = 0;
+            for (auto& bucket : this->buckets_) {
+                bucket = 0;
+            }
+        }
+
+        void log(const char* tag, const char* name) const
+        {
+            if (this->count_ == 0) {
+                ESP_LOGCONFIG(tag, "  %s: no samples", name);
+                return;
+            }
+            float mhz = arch_get_cpu_freq_hz() / 1000000.0f;
+            ESP_LOGCONFIG(tag, "  %s: n=%" PRIu32 " min=%.1fus avg=%.1fus max=%.1fus p99=%.1fus", name, this->count_,
+                this->min_ / mhz, (this->total_ / this->count_) / mhz, this->max_ / mhz, this->percentile(99) / mhz);
+        }
+
+    protected:
+        static uint8_t bucket(uint32_t cycles)
+        {
+            if (cycles < 2) {
+                return cycles;
+            }
+            uint8_t msb = 31 - __builtin_clz(cycles);
+            uint8_t half = (cycles >> (msb - 1)) & 1;
+            return msb * 2 + half;
+        }
+
+        // upper bound of the bucket
+        static uint32_t bucket_limit(uint8_t bucket)
+        {
+            if (bucket < 2) {
+                return bucket;
+            }
+            uint8_t msb = bucket / 2;
+            uint64_t limit = (1ULL << msb) + ((bucket & 1) + 1) * (1ULL << (msb - 1)) - 1;
+            return limit > UINT32_MAX ? UINT32_MAX : limit;
+        }
+
+        uint32_t percentile(uint8_t pct) const
+        {
+            uint32_t target = (static_cast<uint64_t>(this->count_) * pct + 99) / 100;
+            uint32_t seen = 0;
+            for (uint8_t i = 0; i < BUCKETS; i++) {
+                seen += this->buckets_[i];
+                if (seen >= target) {
+                    return std::min(bucket_limit(i), this->max_);
+                }
+            }
+            return this->max_;
+        }
+
+        uint32_t count_ { 0 };
+        uint64_t total_ { 0 };
+        uint32_t min_ { UINT32_MAX };
+        uint32_t max_ { 0 };
+        uint32_t buckets_[BUCKETS] {};
+    };
+
+    class ScopedProfile {
+    public:
+        explicit ScopedProfile(SectionProfile& profile)
+            : profile_(profile)
+            , start_(arch_get_cpu_cycle_count())
+        {
+        }
+        ~ScopedProfile() { this->profile_.record(arch_get_cpu_cycle_count() - this->start_); }
+
+    protected:
+        SectionProfile& profile_;
+        uint32_t start_;
+    };
+
+    struct LoopProfiles {
+        SectionProfile loop;
+        SectionProfile obstruction_loop;
+        SectionProfile protocol_loop;
+        SectionProfile read_command;
+        SectionProfile handle_command;
+        SectionProfile transmit_packet;
+
+        void log(const char* tag) const
+        {
+            this->loop.log(tag, "loop");
+            this->obstruction_loop.log(tag, "obstruction_loop");
+            this->protocol_loop.log(tag, "protocol loop");
+            this->read_command.log(tag, "read_command");
+            this->handle_command.log(tag, "handle_command");
+            this->transmit_packet.log(tag, "transmit");
+        }
+
+        void reset()
+        {
+            this->loop.reset();
+            this->obstruction_loop.reset();
+            this->protocol_loop.reset();
+            this->read_command.reset();
+            this->handle_command.reset();
+            this->transmit_packet.reset();
+        }
+    };
+
+// times the rest of the enclosing scope
+#define RATGDO_PROFILE_SCOPE(profile) ScopedProfile ratgdo_profile_scope_ { profile }
+
+#else
+
+#define RATGDO_PROFILE_SCOPE(profile)
+
+#endif
+
+} // namespace ratgdo
+} // namespace esphome
@@ -50,6 +50,16 @@ namespace ratgdo {
             }
         };
 
+        // link health counters kept by the protocol's RX/TX paths
+        struct ProtocolStats {
+            uint32_t frames_received;
+            uint32_t frames_sent;
+            uint32_t incomplete_frames; // partial packets discarded after a timeout
+            uint32_t ignored_bytes; // bytes outside of a packet
+            uint32_t collisions; // bus busy when we wanted to transmit
+            uint32_t decode_errors;
+        };
+
         struct SetRollingCodeCounter {
             uint32_t counter;
         };
@@ -74,6 +84,8 @@ namespace ratgdo {
         struct ClearPairedDevices {
             PairedDevice kind;
         };
+        struct GetProtocolStats {
+        };
 
         // a poor man's sum-type, because C++
         SUM_TYPE(Args,
@@ -86,32 +98,34 @@ namespace ratgdo {
             (InactivateLearn, inactivate_learn),
             (QueryPairedDevices, query_paired_devices),
             (QueryPairedDevicesAll, query_paired_devices_all),
-            (ClearPairedDevices, clear_paired_devices), )
+            (ClearPairedDevices, clear_paired_devices),
+            (GetProtocolStats, get_protocol_stats), )
 
         struct RollingCodeCounter {
             observable<uint32_t>* value;
         };
 
-        SUM_TYPE(Result,
-            (RollingCodeCounter, rolling_code_counter), )
-
-        class Protocol {
-        public:
-            virtual void setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin);
-            virtual void loop();
-            virtual void dump_config();
-
-            virtual void sync();
-
-            virtual const Traits& traits() const;
-
-            virtual void light_action(LightAction action);
-            virtual void lock_action(LockAction action);
-            virtual void door_action(DoorAction action);
-
-            virtual protocol::Result call(protocol::Args args);
+        struct ProtocolStatsRef {
+            const ProtocolStats* value;
         };
 
+        SUM_TYPE(Result,
+            (RollingCodeCounter, rolling_code_counter),
+            (ProtocolStatsRef, protocol_stats), )
+
+        // A protocol is picked at codegen time (see GdoProtocol in ratgdo.h) and
+        // called directly, so there is no virtual base. Every protocol provides:
+        //
+        //   void setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin);
+        //   void loop();
+        //   void dump_config();
+        //   void sync();
+        //   const Traits& traits() const;
+        //   void light_action(LightAction action);
+        //   void lock_action(LockAction action);
+        //   void door_action(DoorAction action);
+        //   protocol::Result call(protocol::Args args);
+
     }
 } // namespace ratgdo
 } // namespace esphome
@@ -13,15 +13,15 @@
 
 #include "ratgdo.h"
 #include "common.h"
-#include "dry_contact.h"
 #include "ratgdo_state.h"
-#include "secplus1.h"
-#include "secplus2.h"
 
 #include "esphome/core/application.h"
 #include "esphome/core/gpio.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 
+#include <cmath>
+
 namespace esphome {
 namespace ratgdo {
 
@@ -29,6 +29,16 @@ namespace ratgdo {
 
     static const char* const TAG = "ratgdo";
     static const int SYNC_DELAY = 1000;
+    static const uint32_t PROTOCOL_STATS_INTERVAL = 60000;
+    // a STOPPED report later than this wasn't caused by our STOP command
+    static const uint32_t MAX_STOP_LATENCY = 3000;
+    static const uint32_t MAX_START_LATENCY = 3000;
+    // a move to position stopping closer than this to the target is good enough
+    static const float MIN_MOVE_CORRECTION = 0.03;
+    static const uint8_t MAX_MOVE_CORRECTIONS = 2;
+#ifdef RATGDO_PROFILE
+    static const uint32_t PROFILE_LOG_INTERVAL = 60000;
+#endif
 
     void RATGDOComponent::setup()
     {
@@ -43,38 +53,105 @@ namespace ratgdo {
             // as well to avoid a breaking change.
             this->obstruction_from_status_ = true;
         } else {
-            this->input_obst_pin_->setup();
-            this->input_obst_pin_->pin_mode(gpio::FLAG_INPUT);
-            this->input_obst_pin_->attach_interrupt(RATGDOStore::isr_obstruction, &this->isr_store_, gpio::INTERRUPT_FALLING_EDGE);
+            this->obstruction_input_.setup(this->input_obst_pin_);
         }
 
-        this->protocol_->setup(this, &App.scheduler, this->input_gdo_pin_, this->output_gdo_pin_);
+        this->protocol_.setup(this, &App.scheduler, this->input_gdo_pin_, this->output_gdo_pin_);
+
+        this->door_motion_pref_ = global_preferences->make_preference<DoorMotionProfiles>(this->preference_hash("ratgdo_door_motion"));
+        DoorMotionProfiles profiles;
+        if (this->door_motion_pref_.load(&profiles)) {
+            // the duration numbers are set up first; theirs win where we
+            // haven't learned a travel yet or it was set by hand
+            float opening = this->door_motion_.profile(true).travel;
+            float closing = this->door_motion_.profile(false).travel;
+            this->door_motion_.profiles() = profiles;
+            if (opening != 0) {
+                this->set_door_travel(true, opening);
+            }
+            if (closing != 0) {
+                this->set_door_travel(false, closing);
+            }
+        }
 
         // many things happening at startup, use some delay for sync
         set_timeout(SYNC_DELAY, [=] { this->sync(); });
-    }
 
-    // initializing protocol, this gets called before setup() because
-    // its children components might require that
-    void RATGDOComponent::init_protocol()
-    {
-#ifdef PROTOCOL_SECPLUSV2
-        this->protocol_ = new secplus2::Secplus2();
-#endif
-#ifdef PROTOCOL_SECPLUSV1
-        this->protocol_ = new secplus1::Secplus1();
-#endif
-#ifdef PROTOCOL_DRYCONTACT
-        this->protocol_ = new dry_contact::DryContact();
+        set_interval("protocol_stats", PROTOCOL_STATS_INTERVAL, [=] { this->update_protocol_stats(); });
+
+#ifdef RATGDO_PROFILE
+        set_interval("profile", PROFILE_LOG_INTERVAL, [=] {
+            ESP_LOGD(TAG, "Loop profile for the last %" PRIu32 "s:", PROFILE_LOG_INTERVAL / 1000);
+            this->profiles.log(TAG);
+            this->profiles.reset();
+        });
 #endif
     }
 
     void RATGDOComponent::loop()
     {
+        RATGDO_PROFILE_SCOPE(this->profiles.loop);
         if (!this->obstruction_from_status_) {
+            RATGDO_PROFILE_SCOPE(this->profiles.obstruction_loop);
             this->obstruction_loop();
         }
-        this->protocol_->loop();
+        {
+            RATGDO_PROFILE_SCOPE(this->profiles.protocol_loop);
+            this->protocol_.loop();
+        }
+        if (*this->door_state == DoorState::OPENING || *this->door_state == DoorState::CLOSING) {
+            this->door_position_update();
+        }
+        this->publish_changes();
+    }
+
+    // Children get state changes once per loop instead of on every change, so
+    // they only see the latest values and nothing is allocated to get there.
+    // Changes made from scheduler callbacks go out with the next loop.
+    void RATGDOComponent::publish_changes()
+    {
+        if (this->rolling_code_counter_ != nullptr) {
+            this->rolling_code_counter_->flush();
+        }
+        this->opening_duration.flush();
+        this->closing_duration.flush();
+        this->openings.flush();
+        this->paired_total.flush();
+        this->paired_remotes.flush();
+        this->paired_keypads.flush();
+        this->paired_wall_controls.flush();
+        this->paired_accessories.flush();
+        // state and position go out together so the cover always gets a coherent pair
+        bool door_changed = this->door_state.take_changed();
+        door_changed |= this->door_position.take_changed();
+        if (door_changed) {
+            this->door_state_observers_.call(*this->door_state, *this->door_position);
+        }
+        this->light_state.flush();
+        this->lock_state.flush();
+        this->obstruction_state.flush();
+        this->obstruction_pulse_period.flush();
+        this->obstruction_pulse_jitter.flush();
+        this->motor_state.flush();
+        this->button_state.flush();
+        this->motion_state.flush();
+        this->learn_state.flush();
+        this->sync_failed.flush();
+        this->frames_received.flush();
+        this->frames_sent.flush();
+        this->incomplete_frames.flush();
+        this->ignored_bytes.flush();
+        this->collisions.flush();
+        this->decode_errors.flush();
+        this->door_model_error.flush();
+        this->door_movement.flush();
+    }
+
+    // Preferences of this opener, apart from those of the others on the
+    // same device: no two instances share their GDO pins
+    uint32_t RATGDOComponent::preference_hash(const std::string& name) const
+    {
+        return fnv1_hash(name + "_" + std::to_string(this->input_gdo_pin_->get_pin()) + "_" + std::to_string(this->output_gdo_pin_->get_pin()));
     }
 
     void RATGDOComponent::dump_config()
@@ -87,7 +164,17 @@ namespace ratgdo {
         } else {
             LOG_PIN("  Input Obstruction Pin: ", this->input_obst_pin_);
         }
-        this->protocol_->dump_config();
+        for (bool opening : { true, false }) {
+            const auto& profile = this->door_motion_.profile(opening);
+            ESP_LOGCONFIG(TAG, "  %s travel: %.0fms, ramp: %.0fms, stop latency: %.0fms", opening ? "Opening" : "Closing",
+                profile.travel, profile.ramp, profile.stop_latency);
+        }
+        ESP_LOGCONFIG(TAG, "  Start latency: %.0fms", this->door_motion_.start_latency());
+        ESP_LOGCONFIG(TAG, "  Position updates: every %.1f%%, at most every %ums", this->position_min_delta_ * 100, this->position_update_interval_);
+        this->protocol_.dump_config();
+#ifdef RATGDO_PROFILE
+        this->profiles.log(TAG);
+#endif
     }
 
     void RATGDOComponent::received(const DoorState door_state)
@@ -100,65 +187,40 @@ namespace ratgdo {
             return;
         }
 
-        // opening duration calibration
-        if (*this->opening_duration == 0) {
-            if (door_state == DoorState::OPENING && prev_door_state == DoorState::CLOSED) {
-                this->start_opening = millis();
-            }
-            if (door_state == DoorState::OPEN && prev_door_state == DoorState::OPENING && this->start_opening > 0) {
-                auto duration = (millis() - this->start_opening) / 1000;
-                this->set_opening_duration(round(duration * 10) / 10);
-            }
-            if (door_state == DoorState::STOPPED) {
-                this->start_opening = -1;
-            }
-        }
-        // closing duration calibration
-        if (*this->closing_duration == 0) {
-            if (door_state == DoorState::CLOSING && prev_door_state == DoorState::OPEN) {
-                this->start_closing = millis();
-            }
-            if (door_state == DoorState::CLOSED && prev_door_state == DoorState::CLOSING && this->start_closing > 0) {
-                auto duration = (millis() - this->start_closing) / 1000;
-                this->set_closing_duration(round(duration * 10) / 10);
-            }
-            if (door_state == DoorState::STOPPED) {
-                this->start_closing = -1;
-            }
-        }
+        this->learn_door_motion(door_state, prev_door_state);
 
         if (door_state == DoorState::OPENING) {
             // door started opening
             if (prev_door_state == DoorState::CLOSING) {
-                this->door_position_update();
+                this->door_position_update(true);
                 this->cancel_position_sync_callbacks();
                 this->door_move_delta = DOOR_DELTA_UNKNOWN;
             }
-            this->door_start_moving = millis();
+            this->door_start_moving = this->door_motion_started();
             this->door_start_position = *this->door_position;
+            this->position_published_at_ = this->door_start_moving;
             if (this->door_move_delta == DOOR_DELTA_UNKNOWN) {
                 this->door_move_delta = 1.0 - this->door_start_position;
             }
-            if (*this->opening_duration != 0) {
-                this->schedule_door_position_sync();
-            }
+            this->publish_door_movement(true);
+            this->schedule_move_stop(true);
         } else if (door_state == DoorState::CLOSING) {
             // door started closing
             if (prev_door_state == DoorState::OPENING) {
-                this->door_position_update();
+                this->door_position_update(true);
                 this->cancel_position_sync_callbacks();
                 this->door_move_delta = DOOR_DELTA_UNKNOWN;
             }
-            this->door_start_moving = millis();
+            this->door_start_moving = this->door_motion_started();
             this->door_start_position = *this->door_position;
+            this->position_published_at_ = this->door_start_moving;
             if (this->door_move_delta == DOOR_DELTA_UNKNOWN) {
                 this->door_move_delta = 0.0 - this->door_start_position;
             }
-            if (*this->closing_duration != 0) {
-                this->schedule_door_position_sync();
-            }
+            this->publish_door_movement(false);
+            this->schedule_move_stop(false);
         } else if (door_state == DoorState::STOPPED) {
-            this->door_position_update();
+            this->door_position_update(true);
             if (*this->door_position == DOOR_POSITION_UNKNOWN) {
                 this->door_position = 0.5; // best guess
             }
@@ -167,23 +229,149 @@ namespace ratgdo {
         } else if (door_state == DoorState::OPEN) {
             this->door_position = 1.0;
             this->cancel_position_sync_callbacks();
+            this->door_move_target_ = DOOR_POSITION_UNKNOWN;
         } else if (door_state == DoorState::CLOSED) {
             this->door_position = 0.0;
             this->cancel_position_sync_callbacks();
+            this->door_move_target_ = DOOR_POSITION_UNKNOWN;
         }
 
         if (door_state == DoorState::OPEN || door_state == DoorState::CLOSED || door_state == DoorState::STOPPED) {
             this->motor_state = MotorState::OFF;
+            this->door_movement = DoorMovement { *this->door_position, 0, 0 };
         }
 
         if (door_state == DoorState::CLOSED && door_state != prev_door_state) {
             this->query_openings();
         }
 
+        // a new state ends whatever the last STOP command was for
+        this->door_stop_requested_ = 0;
+
         this->door_state = door_state;
+
+        if (door_state == DoorState::STOPPED) {
+            this->correct_door_move();
+        }
+
         this->on_door_state_.trigger(door_state);
     }
 
+    // When the door started moving: the MOTOR_ON frame comes ahead of the
+    // OPENING/CLOSING status, use it if we saw one for this start
+    uint32_t RATGDOComponent::door_motion_started()
+    {
+        uint32_t now = millis();
+        uint32_t started = now;
+        if (this->motor_started_ != 0 && now - this->motor_started_ < MAX_START_LATENCY) {
+            started = this->motor_started_;
+        }
+        this->motor_started_ = 0;
+
+        if (this->door_command_sent_ != 0) {
+            uint32_t latency = started - this->door_command_sent_;
+            this->door_command_sent_ = 0;
+            if (latency < MAX_START_LATENCY) {
+                this->door_motion_.learn_start_latency(latency);
+                this->door_motion_pref_.save(&this->door_motion_.profiles());
+                ESP_LOGD(TAG, "Door started %" PRIu32 "ms after the command, start latency: %.0fms",
+                    latency, this->door_motion_.start_latency());
+            }
+        }
+        return started;
+    }
+
+    // Schedules the STOP of a move to position from when the door was seen to
+    // start moving, so command queueing and the opener's reaction time don't
+    // add to the travel
+    void RATGDOComponent::schedule_move_stop(bool opening)
+    {
+        if (this->door_move_target_ == DOOR_POSITION_UNKNOWN) {
+            return;
+        }
+        auto delta = this->door_move_target_ - this->door_start_position;
+        if ((delta > 0) != opening || this->door_start_position == DOOR_POSITION_UNKNOWN) {
+            ESP_LOGD(TAG, "Door moves the other way, abandoning move to %.2f", this->door_move_target_);
+            this->door_move_target_ = DOOR_POSITION_UNKNOWN;
+            cancel_timeout("move_to_position");
+            return;
+        }
+        this->door_move_delta = delta;
+
+        // send STOP early by the distance the door keeps going after it
+        float limit = opening ? 1.0f - this->door_start_position : this->door_start_position;
+        auto travel = this->door_motion_.time_to(opening, std::fabs(delta) - this->door_motion_.stop_distance(opening), limit);
+        int32_t remaining = static_cast<int32_t>(travel) - static_cast<int32_t>(millis() - this->door_start_moving);
+        ESP_LOGD(TAG, "Moving to position %.2f, stopping in %" PRId32 "ms", this->door_move_target_, remaining);
+        set_timeout("move_to_position", std::max<int32_t>(remaining, 0), [=] {
+            this->door_action(DoorAction::STOP);
+        });
+    }
+
+    // Once a move to position stopped, moves again if the estimate says it
+    // ended up too far from the target
+    void RATGDOComponent::correct_door_move()
+    {
+        if (this->door_move_target_ == DOOR_POSITION_UNKNOWN) {
+            return;
+        }
+        auto target = this->door_move_target_;
+        this->door_move_target_ = DOOR_POSITION_UNKNOWN;
+        auto error = target - *this->door_position;
+        if (std::fabs(error) < MIN_MOVE_CORRECTION) {
+            return;
+        }
+        if (this->door_move_corrections_ >= MAX_MOVE_CORRECTIONS) {
+            ESP_LOGW(TAG, "Door stopped at %.2f, missed target %.2f", *this->door_position, target);
+            return;
+        }
+        this->door_move_corrections_++;
+        ESP_LOGD(TAG, "Door stopped at %.2f, correcting towards %.2f", *this->door_position, target);
+        this->move_door_to(target);
+    }
+
+    void RATGDOComponent::learn_door_motion(DoorState door_state, DoorState prev_door_state)
+    {
+        if (prev_door_state != DoorState::OPENING && prev_door_state != DoorState::CLOSING) {
+            return;
+        }
+        if (this->door_start_moving == 0 || this->door_start_position == DOOR_POSITION_UNKNOWN) {
+            return;
+        }
+        bool opening = prev_door_state == DoorState::OPENING;
+        uint32_t now = millis();
+
+        if (door_state == (opening ? DoorState::OPEN : DoorState::CLOSED)) {
+            float limit = opening ? 1.0f - this->door_start_position : this->door_start_position;
+            uint32_t elapsed = now - this->door_start_moving;
+            auto error = this->door_motion_.learn_travel(opening, limit, elapsed);
+            const auto& profile = this->door_motion_.profile(opening);
+            ESP_LOGD(TAG, "Door %s from %.2f in %" PRIu32 "ms, prediction off by %.1f%%, travel: %.0fms, ramp: %.0fms",
+                opening ? "opened" : "closed", this->door_start_position, elapsed, error * 100, profile.travel, profile.ramp);
+
+            auto duration = std::round(profile.travel / 100) / 10;
+            if (opening) {
+                this->opening_duration = duration;
+            } else {
+                this->closing_duration = duration;
+            }
+            if (this->door_motion_.error() >= 0) {
+                this->door_model_error = this->door_motion_.error() * 100;
+            }
+        } else if (door_state == DoorState::STOPPED && this->door_stop_requested_ != 0) {
+            uint32_t latency = now - this->door_stop_requested_;
+            if (latency > MAX_STOP_LATENCY) {
+                return;
+            }
+            this->door_motion_.learn_stop_latency(opening, latency);
+            ESP_LOGD(TAG, "Door stopped %" PRIu32 "ms after the command, stop latency: %.0fms",
+                latency, this->door_motion_.profile(opening).stop_latency);
+        } else {
+            return;
+        }
+        this->door_motion_pref_.save(&this->door_motion_.profiles());
+    }
+
     void RATGDOComponent::received(const LearnState learn_state)
     {
         ESP_LOGD(TAG, "Learn state=%s", LearnState_to_string(learn_state));
@@ -226,6 +414,9 @@ namespace ratgdo {
     void RATGDOComponent::received(const MotorState motor_state)
     {
         ESP_LOGD(TAG, "Motor: state=%s", MotorState_to_string(*this->motor_state));
+        if (motor_state == MotorState::ON && *this->door_state != DoorState::OPENING && *this->door_state != DoorState::CLOSING) {
+            this->motor_started_ = millis();
+        }
         this->motor_state = motor_state;
     }
 
@@ -300,128 +491,152 @@ namespace ratgdo {
         ESP_LOGD(TAG, "Battery state=%s", BatteryState_to_string(battery_state));
     }
 
-    void RATGDOComponent::schedule_door_position_sync(float update_period)
+    // tells clients once where the door is going and when it should get there,
+    // so they can interpolate between the (rate limited) position updates
+    void RATGDOComponent::publish_door_movement(bool opening)
     {
-        ESP_LOG1(TAG, "Schedule position sync: delta %f, start position: %f, start moving: %d",
-            this->door_move_delta, this->door_start_position, this->door_start_moving);
-        auto duration = this->door_move_delta > 0 ? *this->opening_duration : *this->closing_duration;
-        if (duration == 0) {
+        if (this->door_start_position == DOOR_POSITION_UNKNOWN || !this->door_motion_.known(opening)) {
             return;
         }
-        auto count = int(1000 * duration / update_period);
-        set_retry("position_sync_while_moving", update_period, count, [=](uint8_t r) {
-            this->door_position_update();
-            return RetryResult::RETRY;
-        });
+        float limit = opening ? 1.0f - this->door_start_position : this->door_start_position;
+        auto duration = this->door_motion_.time_to(opening, limit, limit);
+        this->door_movement = DoorMovement { this->door_start_position, static_cast<int8_t>(opening ? 1 : -1), static_cast<uint32_t>(duration) };
     }
 
-    void RATGDOComponent::door_position_update()
+    // Publishes the estimated position while the door moves, at most every
+    // position_update_interval_ and only when it moved position_min_delta_.
+    // force skips both, for state changes that need the exact position.
+    void RATGDOComponent::door_position_update(bool force)
     {
         if (this->door_start_moving == 0 || this->door_start_position == DOOR_POSITION_UNKNOWN || this->door_move_delta == DOOR_DELTA_UNKNOWN) {
             return;
         }
-        auto now = millis();
-        auto duration = this->door_move_delta > 0 ? *this->opening_duration : -*this->closing_duration;
-        if (duration == 0) {
+        uint32_t now = millis();
+        if (!force && now - this->position_published_at_ < this->position_update_interval_) {
+            return;
+        }
+        bool opening = this->door_move_delta > 0;
+        if (!this->door_motion_.known(opening)) {
+            return;
+        }
+        float limit = opening ? 1.0f - this->door_start_position : this->door_start_position;
+        auto distance = this->door_motion_.distance(opening, now - this->door_start_moving, limit);
+        if (this->door_stop_requested_ != 0) {
+            // after a STOP command the door only keeps going for the learned stop distance
+            auto moved = static_cast<int32_t>(this->door_stop_requested_ - this->door_start_moving);
+            auto stopped = this->door_motion_.distance(opening, std::max<int32_t>(moved, 0), limit) + this->door_motion_.stop_distance(opening);
+            distance = std::min(distance, stopped);
+        }
+        auto position = clamp(this->door_start_position + (opening ? distance : -distance), 0.0f, 1.0f);
+        if (!force && std::fabs(position - *this->door_position) < this->position_min_delta_) {
             return;
         }
-        auto position = this->door_start_position + (now - this->door_start_moving) / (1000 * duration);
         ESP_LOG2(TAG, "[%d] Position update: %f", now, position);
-        this->door_position = clamp(position, 0.0f, 1.0f);
+        this->position_published_at_ = now;
+        this->door_position = position;
     }
 
     void RATGDOComponent::set_opening_duration(float duration)
     {
         ESP_LOGD(TAG, "Set opening duration: %.1fs", duration);
         this->opening_duration = duration;
+        this->set_door_travel(true, duration * 1000);
     }
 
     void RATGDOComponent::set_closing_duration(float duration)
     {
         ESP_LOGD(TAG, "Set closing duration: %.1fs", duration);
         this->closing_duration = duration;
+        this->set_door_travel(false, duration * 1000);
+    }
+
+    // The durations are the learned travel rounded to 0.1s, only a real
+    // change replaces it. Saving does nothing until setup() made the
+    // preference, which then compares again.
+    void RATGDOComponent::set_door_travel(bool opening, float travel)
+    {
+        auto& profile = this->door_motion_.profile(opening);
+        if (std::fabs(profile.travel - travel) <= 50) {
+            return;
+        }
+        profile.travel = travel;
+        // learned against the old travel
+        profile.ramp = 0;
+        this->door_motion_pref_.save(&this->door_motion_.profiles());
     }
 
     Result RATGDOComponent::call_protocol(Args args)
     {
-        return this->protocol_->call(args);
+        return this->protocol_.call(args);
     }
 
     /*************************** OBSTRUCTION DETECTION ***************************/
 
     void RATGDOComponent::obstruction_loop()
     {
-        long current_millis = millis();
-        static unsigned long last_millis = 0;
-        static unsigned long last_asleep = 0;
-
-        // the obstruction sensor has 3 states: clear (HIGH with LOW pulse every 7ms), obstructed (HIGH), asleep (LOW)
-        // the transitions between awake and asleep are tricky because the voltage drops slowly when falling asleep
-        // and is high without pulses when waking up
-
-        // If at least 3 low pulses are counted within 50ms, the door is awake, not obstructed and we don't have to check anything else
-
-        const long CHECK_PERIOD = 50;
-        const long PULSES_LOWER_LIMIT = 3;
-
-        if (current_millis - last_millis > CHECK_PERIOD) {
-            // ESP_LOGD(TAG, "%ld: Obstruction count: %d, expected: %d, since asleep: %ld",
-            //     current_millis, this->isr_store_.obstruction_low_count, PULSES_EXPECTED,
-            //     current_millis - last_asleep
-            // );
-
-            // check to see if we got more then PULSES_LOWER_LIMIT pulses
-            if (this->isr_store_.obstruction_low_count > PULSES_LOWER_LIMIT) {
-                this->obstruction_state = ObstructionState::CLEAR;
-            } else if (this->isr_store_.obstruction_low_count == 0) {
-                // if there have been no pulses the line is steady high or low
-                if (!this->input_obst_pin_->digital_read()) {
-                    // asleep
-                    last_asleep = current_millis;
-                } else {
-                    // if the line is high and was last asleep more than 700ms ago, then there is an obstruction present
-                    if (current_millis - last_asleep > 700) {
-                        this->obstruction_state = ObstructionState::OBSTRUCTED;
-                    }
-                }
+        auto pulses = this->obstruction_input_.take();
+        auto state = this->obstruction_detector_.update(pulses, this->obstruction_input_.line_high(), micros());
+        if (state != ObstructionState::UNKNOWN) {
+            this->obstruction_state = state;
+        }
+        ObstructionStats stats;
+        if (this->obstruction_detector_.take_stats(stats)) {
+            this->obstruction_pulse_period = stats.period;
+            if (!std::isnan(stats.jitter)) {
+                this->obstruction_pulse_jitter = stats.jitter;
             }
-            last_millis = current_millis;
-            this->isr_store_.obstruction_low_count = 0;
         }
     }
 
     void RATGDOComponent::query_status()
     {
-        this->protocol_->call(QueryStatus {});
+        this->protocol_.call(QueryStatus {});
     }
 
     void RATGDOComponent::query_openings()
     {
-        this->protocol_->call(QueryOpenings {});
+        this->protocol_.call(QueryOpenings {});
     }
 
     void RATGDOComponent::query_paired_devices()
     {
-        this->protocol_->call(QueryPairedDevicesAll {});
+        this->protocol_.call(QueryPairedDevicesAll {});
     }
 
     void RATGDOComponent::query_paired_devices(PairedDevice kind)
     {
-        this->protocol_->call(QueryPairedDevices { kind });
+        this->protocol_.call(QueryPairedDevices { kind });
     }
 
     void RATGDOComponent::clear_paired_devices(PairedDevice kind)
     {
-        this->protocol_->call(ClearPairedDevices { kind });
+        this->protocol_.call(ClearPairedDevices { kind });
     }
 
     void RATGDOComponent::sync()
     {
-        this->protocol_->sync();
+        this->protocol_.sync();
+    }
+
+    void RATGDOComponent::update_protocol_stats()
+    {
+        auto result = this->protocol_.call(GetProtocolStats {});
+        if (result.tag != Result::Tag::protocol_stats) {
+            return;
+        }
+        const auto* stats = result.value.protocol_stats.value;
+        this->frames_received = stats->frames_received;
+        this->frames_sent = stats->frames_sent;
+        this->incomplete_frames = stats->incomplete_frames;
+        this->ignored_bytes = stats->ignored_bytes;
+        this->collisions = stats->collisions;
+        this->decode_errors = stats->decode_errors;
     }
 
     void RATGDOComponent::door_open()
     {
+        this->door_move_target_ = DOOR_POSITION_UNKNOWN;
+        this->on_door_state_.clear();
         if (*this->door_state == DoorState::OPENING) {
             return; // gets ignored by opener
         }
@@ -441,6 +656,8 @@ namespace ratgdo {
 
     void RATGDOComponent::door_close()
     {
+        this->door_move_target_ = DOOR_POSITION_UNKNOWN;
+        this->on_door_state_.clear();
         if (*this->door_state == DoorState::CLOSING) {
             return; // gets ignored by opener
         }
@@ -473,6 +690,8 @@ namespace ratgdo {
 
     void RATGDOComponent::door_stop()
     {
+        this->door_move_target_ = DOOR_POSITION_UNKNOWN;
+        this->on_door_state_.clear();
         if (*this->door_state != DoorState::OPENING && *this->door_state != DoorState::CLOSING) {
             ESP_LOGW(TAG, "The door is not moving.");
             return;
@@ -482,21 +701,37 @@ namespace ratgdo {
 
     void RATGDOComponent::door_toggle()
     {
+        this->door_move_target_ = DOOR_POSITION_UNKNOWN;
+        this->on_door_state_.clear();
         this->door_action(DoorAction::TOGGLE);
     }
 
     void RATGDOComponent::door_action(DoorAction action)
     {
-        this->protocol_->door_action(action);
+        bool moving = *this->door_state == DoorState::OPENING || *this->door_state == DoorState::CLOSING;
+        if (action == DoorAction::STOP && moving) {
+            this->door_stop_requested_ = millis();
+        } else if (action != DoorAction::STOP && !moving) {
+            this->door_command_sent_ = millis();
+        }
+        this->protocol_.door_action(action);
     }
 
     void RATGDOComponent::door_move_to_position(float position)
+    {
+        this->door_move_corrections_ = 0;
+        this->move_door_to(position);
+    }
+
+    void RATGDOComponent::move_door_to(float position)
     {
         if (*this->door_state == DoorState::OPENING || *this->door_state == DoorState::CLOSING) {
+            this->door_move_target_ = DOOR_POSITION_UNKNOWN;
             this->door_action(DoorAction::STOP);
+            this->on_door_state_.clear();
             this->on_door_state_([=](DoorState s) {
                 if (s == DoorState::STOPPED) {
-                    this->door_move_to_position(position);
+                    this->move_door_to(position);
                 }
             });
             return;
@@ -508,19 +743,21 @@ namespace ratgdo {
             return;
         }
 
-        auto duration = delta > 0 ? *this->opening_duration : -*this->closing_duration;
-        if (duration == 0) {
+        bool opening = delta > 0;
+        if (!this->door_motion_.known(opening)) {
             ESP_LOGW(TAG, "I don't know duration, ignoring move to position");
             return;
         }
 
-        auto operation_time = 1000 * duration * delta;
-        this->door_move_delta = delta;
-        ESP_LOGD(TAG, "Moving to position %.2f in %.1fs", position, operation_time / 1000.0);
-
-        this->door_action(delta > 0 ? DoorAction::OPEN : DoorAction::CLOSE);
-        set_timeout("move_to_position", operation_time, [=] {
-            this->door_action(DoorAction::STOP);
+        // the STOP is scheduled once the door reports it started moving,
+        // give up if that doesn't happen
+        this->door_move_target_ = position;
+        this->door_action(opening ? DoorAction::OPEN : DoorAction::CLOSE);
+        set_timeout("move_to_position", this->door_motion_.start_latency() + MAX_START_LATENCY, [=] {
+            if (this->door_move_target_ != DOOR_POSITION_UNKNOWN) {
+                ESP_LOGW(TAG, "Door did not start moving, ignoring move to position");
+                this->door_move_target_ = DOOR_POSITION_UNKNOWN;
+            }
         });
     }
 
@@ -529,7 +766,6 @@ namespace ratgdo {
         if (this->door_start_moving != 0) {
             ESP_LOGD(TAG, "Cancelling position callbacks");
             cancel_timeout("move_to_position");
-            cancel_retry("position_sync_while_moving");
 
             this->door_start_moving = 0;
             this->door_start_position = DOOR_POSITION_UNKNOWN;
@@ -540,19 +776,19 @@ namespace ratgdo {
     void RATGDOComponent::light_on()
     {
         this->light_state = LightState::ON;
-        this->protocol_->light_action(LightAction::ON);
+        this->protocol_.light_action(LightAction::ON);
     }
 
     void RATGDOComponent::light_off()
     {
         this->light_state = LightState::OFF;
-        this->protocol_->light_action(LightAction::OFF);
+        this->protocol_.light_action(LightAction::OFF);
     }
 
     void RATGDOComponent::light_toggle()
     {
         this->light_state = light_state_toggle(*this->light_state);
-        this->protocol_->light_action(LightAction::TOGGLE);
+        this->protocol_.light_action(LightAction::TOGGLE);
     }
 
     LightState RATGDOComponent::get_light_state() const
@@ -564,113 +800,157 @@ namespace ratgdo {
     void RATGDOComponent::lock()
     {
         this->lock_state = LockState::LOCKED;
-        this->protocol_->lock_action(LockAction::LOCK);
+        this->protocol_.lock_action(LockAction::LOCK);
     }
 
     void RATGDOComponent::unlock()
     {
         this->lock_state = LockState::UNLOCKED;
-        this->protocol_->lock_action(LockAction::UNLOCK);
+        this->protocol_.lock_action(LockAction::UNLOCK);
     }
 
     void RATGDOComponent::lock_toggle()
     {
         this->lock_state = lock_state_toggle(*this->lock_state);
-        this->protocol_->lock_action(LockAction::TOGGLE);
+        this->protocol_.lock_action(LockAction::TOGGLE);
     }
 
     // Learn functions
     void RATGDOComponent::activate_learn()
     {
-        this->protocol_->call(ActivateLearn {});
+        this->protocol_.call(ActivateLearn {});
     }
 
     void RATGDOComponent::inactivate_learn()
     {
-        this->protocol_->call(InactivateLearn {});
+        this->protocol_.call(InactivateLearn {});
     }
 
-    void RATGDOComponent::subscribe_rolling_code_counter(std::function<void(uint32_t)>&& f)
+    // Observers have fixed slots, sized for one entity per config entry. An
+    // entity left without updates is worse than a loud failure
+    void RATGDOComponent::subscribed(bool added)
     {
-        // change update to children is defered until after component loop
-        // if multiple changes occur during component loop, only the last one is notified
-        auto counter = this->protocol_->call(GetRollingCodeCounter {});
+        if (!added) {
+            ESP_LOGE(TAG, "More entities subscribed to one value than it has room for");
+            this->mark_failed();
+        }
+    }
+
+    void RATGDOComponent::subscribe_rolling_code_counter(observable<uint32_t>::Observer&& f)
+    {
+        auto counter = this->protocol_.call(GetRollingCodeCounter {});
         if (counter.tag == Result::Tag::rolling_code_counter) {
-            counter.value.rolling_code_counter.value->subscribe([=](uint32_t state) { defer("rolling_code_counter", [=] { f(state); }); });
+            this->rolling_code_counter_ = counter.value.rolling_code_counter.value;
+            this->subscribed(this->rolling_code_counter_->subscribe(std::move(f)));
         }
     }
-    void RATGDOComponent::subscribe_opening_duration(std::function<void(float)>&& f)
+    void RATGDOComponent::subscribe_opening_duration(observable<float>::Observer&& f)
     {
-        this->opening_duration.subscribe([=](float state) { defer("opening_duration", [=] { f(state); }); });
+        this->subscribed(this->opening_duration.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_closing_duration(std::function<void(float)>&& f)
+    void RATGDOComponent::subscribe_closing_duration(observable<float>::Observer&& f)
     {
-        this->closing_duration.subscribe([=](float state) { defer("closing_duration", [=] { f(state); }); });
+        this->subscribed(this->closing_duration.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_openings(std::function<void(uint16_t)>&& f)
+    void RATGDOComponent::subscribe_openings(observable<uint16_t>::Observer&& f)
     {
-        this->openings.subscribe([=](uint16_t state) { defer("openings", [=] { f(state); }); });
+        this->subscribed(this->openings.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_paired_devices_total(std::function<void(uint16_t)>&& f)
+    void RATGDOComponent::subscribe_paired_devices_total(observable<uint16_t>::Observer&& f)
     {
-        this->paired_total.subscribe([=](uint16_t state) { defer("paired_total", [=] { f(state); }); });
+        this->subscribed(this->paired_total.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_paired_remotes(std::function<void(uint16_t)>&& f)
+    void RATGDOComponent::subscribe_paired_remotes(observable<uint16_t>::Observer&& f)
     {
-        this->paired_remotes.subscribe([=](uint16_t state) { defer("paired_remotes", [=] { f(state); }); });
+        this->subscribed(this->paired_remotes.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_paired_keypads(std::function<void(uint16_t)>&& f)
+    void RATGDOComponent::subscribe_paired_keypads(observable<uint16_t>::Observer&& f)
     {
-        this->paired_keypads.subscribe([=](uint16_t state) { defer("paired_keypads", [=] { f(state); }); });
+        this->subscribed(this->paired_keypads.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_paired_wall_controls(std::function<void(uint16_t)>&& f)
+    void RATGDOComponent::subscribe_paired_wall_controls(observable<uint16_t>::Observer&& f)
     {
-        this->paired_wall_controls.subscribe([=](uint16_t state) { defer("paired_wall_controls", [=] { f(state); }); });
+        this->subscribed(this->paired_wall_controls.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_paired_accessories(std::function<void(uint16_t)>&& f)
+    void RATGDOComponent::subscribe_paired_accessories(observable<uint16_t>::Observer&& f)
     {
-        this->paired_accessories.subscribe([=](uint16_t state) { defer("paired_accessories", [=] { f(state); }); });
+        this->subscribed(this->paired_accessories.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_door_state(std::function<void(DoorState, float)>&& f)
+    void RATGDOComponent::subscribe_door_state(DoorStateObserver&& f)
     {
-        this->door_state.subscribe([=](DoorState state) {
-            defer("door_state", [=] { f(state, *this->door_position); });
-        });
-        this->door_position.subscribe([=](float position) {
-            defer("door_state", [=] { f(*this->door_state, position); });
-        });
+        this->subscribed(this->door_state_observers_.add(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_light_state(observable<LightState>::Observer&& f)
+    {
+        this->subscribed(this->light_state.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_lock_state(observable<LockState>::Observer&& f)
+    {
+        this->subscribed(this->lock_state.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_obstruction_state(observable<ObstructionState>::Observer&& f)
+    {
+        this->subscribed(this->obstruction_state.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_obstruction_pulse_period(observable<float>::Observer&& f)
+    {
+        this->subscribed(this->obstruction_pulse_period.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_obstruction_pulse_jitter(observable<float>::Observer&& f)
+    {
+        this->subscribed(this->obstruction_pulse_jitter.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_motor_state(observable<MotorState>::Observer&& f)
+    {
+        this->subscribed(this->motor_state.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_button_state(observable<ButtonState>::Observer&& f)
+    {
+        this->subscribed(this->button_state.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_motion_state(observable<MotionState>::Observer&& f)
+    {
+        this->subscribed(this->motion_state.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_sync_failed(observable<bool>::Observer&& f)
+    {
+        this->subscribed(this->sync_failed.subscribe(std::move(f)));
+    }
+    void RATGDOComponent::subscribe_learn_state(observable<LearnState>::Observer&& f)
+    {
+        this->subscribed(this->learn_state.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_light_state(std::function<void(LightState)>&& f)
+    void RATGDOComponent::subscribe_frames_received(observable<uint32_t>::Observer&& f)
     {
-        this->light_state.subscribe([=](LightState state) { defer("light_state", [=] { f(state); }); });
+        this->subscribed(this->frames_received.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_lock_state(std::function<void(LockState)>&& f)
+    void RATGDOComponent::subscribe_frames_sent(observable<uint32_t>::Observer&& f)
     {
-        this->lock_state.subscribe([=](LockState state) { defer("lock_state", [=] { f(state); }); });
+        this->subscribed(this->frames_sent.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_obstruction_state(std::function<void(ObstructionState)>&& f)
+    void RATGDOComponent::subscribe_incomplete_frames(observable<uint32_t>::Observer&& f)
     {
-        this->obstruction_state.subscribe([=](ObstructionState state) { defer("obstruction_state", [=] { f(state); }); });
+        this->subscribed(this->incomplete_frames.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_motor_state(std::function<void(MotorState)>&& f)
+    void RATGDOComponent::subscribe_ignored_bytes(observable<uint32_t>::Observer&& f)
     {
-        this->motor_state.subscribe([=](MotorState state) { defer("motor_state", [=] { f(state); }); });
+        this->subscribed(this->ignored_bytes.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_button_state(std::function<void(ButtonState)>&& f)
+    void RATGDOComponent::subscribe_collisions(observable<uint32_t>::Observer&& f)
     {
-        this->button_state.subscribe([=](ButtonState state) { defer("button_state", [=] { f(state); }); });
+        this->subscribed(this->collisions.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_motion_state(std::function<void(MotionState)>&& f)
+    void RATGDOComponent::subscribe_decode_errors(observable<uint32_t>::Observer&& f)
     {
-        this->motion_state.subscribe([=](MotionState state) { defer("motion_state", [=] { f(state); }); });
+        this->subscribed(this->decode_errors.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_sync_failed(std::function<void(bool)>&& f)
+    void RATGDOComponent::subscribe_door_model_error(observable<float>::Observer&& f)
     {
-        this->sync_failed.subscribe(std::move(f));
+        this->subscribed(this->door_model_error.subscribe(std::move(f)));
     }
-    void RATGDOComponent::subscribe_learn_state(std::function<void(LearnState)>&& f)
+    void RATGDOComponent::subscribe_door_movement(observable<DoorMovement>::Observer&& f)
     {
-        this->learn_state.subscribe([=](LearnState state) { defer("learn_state", [=] { f(state); }); });
+        this->subscribed(this->door_movement.subscribe(std::move(f)));
     }
 
 } // namespace ratgdo
@@ -14,15 +14,27 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/defines.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/preferences.h"
 
 #include "callbacks.h"
+#include "door_motion.h"
+#include "obstruction.h"
 #include "macros.h"
 #include "observable.h"
+#include "profiler.h"
 #include "protocol.h"
 #include "ratgdo_state.h"
 
+#if defined(PROTOCOL_SECPLUSV1)
+#include "secplus1.h"
+#elif defined(PROTOCOL_DRYCONTACT)
+#include "dry_contact.h"
+#else
+#include "secplus2.h"
+#endif
+
 namespace esphome {
 class InternalGPIOPin;
 namespace ratgdo {
@@ -32,34 +44,46 @@ namespace ratgdo {
 
     const float DOOR_POSITION_UNKNOWN = -1.0;
     const float DOOR_DELTA_UNKNOWN = -2.0;
-    const uint16_t PAIRED_DEVICES_UNKNOWN = 0xFF;
 
-    struct RATGDOStore {
-        int obstruction_low_count = 0; // count obstruction low pulses
+    // where the door started, which way it goes and in how many ms it
+    // should reach the limit, direction is 0 once it stopped
+    struct DoorMovement {
+        float position { DOOR_POSITION_UNKNOWN };
+        int8_t direction { 0 };
+        uint32_t duration { 0 };
 
-        static void IRAM_ATTR HOT isr_obstruction(RATGDOStore* arg)
+        bool operator!=(const DoorMovement& other) const
         {
-            arg->obstruction_low_count++;
+            return this->position != other.position || this->direction != other.direction || this->duration != other.duration;
         }
     };
+    const uint16_t PAIRED_DEVICES_UNKNOWN = 0xFF;
 
     using protocol::Args;
     using protocol::Result;
 
+    // the protocol is fixed by the config, calls to it are direct and can be inlined
+#if defined(PROTOCOL_SECPLUSV1)
+    using GdoProtocol = secplus1::Secplus1;
+#elif defined(PROTOCOL_DRYCONTACT)
+    using GdoProtocol = dry_contact::DryContact;
+#else
+    using GdoProtocol = secplus2::Secplus2;
+#endif
+
+    using DoorStateObserver = Callbacks<void(DoorState, float), 2>::Callback;
+
     class RATGDOComponent : public Component {
     public:
         void setup() override;
         void loop() override;
         void dump_config() override;
 
-        void init_protocol();
-
         void obstruction_loop();
 
-        float start_opening { -1 };
         observable<float> opening_duration { 0 };
-        float start_closing { -1 };
         observable<float> closing_duration { 0 };
+        observable<float> door_model_error { NAN }; // % of travel, running average
 
         observable<uint16_t> openings { 0 }; // number of times the door has been opened
         observable<uint16_t> paired_total { PAIRED_DEVICES_UNKNOWN };
@@ -74,19 +98,35 @@ namespace ratgdo {
         unsigned long door_start_moving { 0 };
         float door_start_position { DOOR_POSITION_UNKNOWN };
         float door_move_delta { DOOR_DELTA_UNKNOWN };
+        observable<DoorMovement> door_movement { DoorMovement {} };
 
         observable<LightState> light_state { LightState::UNKNOWN };
         observable<LockState> lock_state { LockState::UNKNOWN };
         observable<ObstructionState> obstruction_state { ObstructionState::UNKNOWN };
+        observable<float> obstruction_pulse_period { NAN }; // ms
+        observable<float> obstruction_pulse_jitter { NAN }; // ms
         observable<MotorState> motor_state { MotorState::UNKNOWN };
         observable<ButtonState> button_state { ButtonState::UNKNOWN };
         observable<MotionState> motion_state { MotionState::UNKNOWN };
         observable<LearnState> learn_state { LearnState::UNKNOWN };
 
-        OnceCallbacks<void(DoorState)> on_door_state_;
+        // what to do once the door stopped, a newer command replaces it
+        OnceCallbacks<void(DoorState), 1> on_door_state_;
 
         observable<bool> sync_failed { false };
 
+        // protocol health, refreshed every PROTOCOL_STATS_INTERVAL
+        observable<uint32_t> frames_received { 0 };
+        observable<uint32_t> frames_sent { 0 };
+        observable<uint32_t> incomplete_frames { 0 };
+        observable<uint32_t> ignored_bytes { 0 };
+        observable<uint32_t> collisions { 0 };
+        observable<uint32_t> decode_errors { 0 };
+
+#ifdef RATGDO_PROFILE
+        LoopProfiles profiles;
+#endif
+
         void set_output_gdo_pin(InternalGPIOPin* pin) { this->output_gdo_pin_ = pin; }
         void set_input_gdo_pin(InternalGPIOPin* pin) { this->input_gdo_pin_ = pin; }
         void set_input_obst_pin(InternalGPIOPin* pin) { this->input_obst_pin_ = pin; }
@@ -119,8 +159,12 @@ namespace ratgdo {
         void set_door_position(float door_position) { this->door_position = door_position; }
         void set_opening_duration(float duration);
         void set_closing_duration(float duration);
-        void schedule_door_position_sync(float update_period = 500);
-        void door_position_update();
+        uint32_t preference_hash(const std::string& name) const;
+
+        void door_position_update(bool force = false);
+        void publish_door_movement(bool opening);
+        void set_position_min_delta(float delta) { this->position_min_delta_ = delta; }
+        void set_position_update_interval(uint32_t interval) { this->position_update_interval_ = interval; }
         void cancel_position_sync_callbacks();
 
         // light
@@ -145,30 +189,65 @@ namespace ratgdo {
         void query_status();
         void query_openings();
         void sync();
+        void update_protocol_stats();
 
         // children subscriptions
-        void subscribe_rolling_code_counter(std::function<void(uint32_t)>&& f);
-        void subscribe_opening_duration(std::function<void(float)>&& f);
-        void subscribe_closing_duration(std::function<void(float)>&& f);
-        void subscribe_openings(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_devices_total(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_remotes(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_keypads(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_wall_controls(std::function<void(uint16_t)>&& f);
-        void subscribe_paired_accessories(std::function<void(uint16_t)>&& f);
-        void subscribe_door_state(std::function<void(DoorState, float)>&& f);
-        void subscribe_light_state(std::function<void(LightState)>&& f);
-        void subscribe_lock_state(std::function<void(LockState)>&& f);
-        void subscribe_obstruction_state(std::function<void(ObstructionState)>&& f);
-        void subscribe_motor_state(std::function<void(MotorState)>&& f);
-        void subscribe_button_state(std::function<void(ButtonState)>&& f);
-        void subscribe_motion_state(std::function<void(MotionState)>&& f);
-        void subscribe_sync_failed(std::function<void(bool)>&& f);
-        void subscribe_learn_state(std::function<void(LearnState)>&& f);
+        void subscribe_rolling_code_counter(observable<uint32_t>::Observer&& f);
+        void subscribe_opening_duration(observable<float>::Observer&& f);
+        void subscribe_closing_duration(observable<float>::Observer&& f);
+        void subscribe_openings(observable<uint16_t>::Observer&& f);
+        void subscribe_paired_devices_total(observable<uint16_t>::Observer&& f);
+        void subscribe_paired_remotes(observable<uint16_t>::Observer&& f);
+        void subscribe_paired_keypads(observable<uint16_t>::Observer&& f);
+        void subscribe_paired_wall_controls(observable<uint16_t>::Observer&& f);
+        void subscribe_paired_accessories(observable<uint16_t>::Observer&& f);
+        void subscribe_door_state(DoorStateObserver&& f);
+        void subscribe_light_state(observable<LightState>::Observer&& f);
+        void subscribe_lock_state(observable<LockState>::Observer&& f);
+        void subscribe_obstruction_state(observable<ObstructionState>::Observer&& f);
+        void subscribe_obstruction_pulse_period(observable<float>::Observer&& f);
+        void subscribe_obstruction_pulse_jitter(observable<float>::Observer&& f);
+        void subscribe_motor_state(observable<MotorState>::Observer&& f);
+        void subscribe_button_state(observable<ButtonState>::Observer&& f);
+        void subscribe_motion_state(observable<MotionState>::Observer&& f);
+        void subscribe_sync_failed(observable<bool>::Observer&& f);
+        void subscribe_learn_state(observable<LearnState>::Observer&& f);
+        void subscribe_frames_received(observable<uint32_t>::Observer&& f);
+        void subscribe_frames_sent(observable<uint32_t>::Observer&& f);
+        void subscribe_incomplete_frames(observable<uint32_t>::Observer&& f);
+        void subscribe_ignored_bytes(observable<uint32_t>::Observer&& f);
+        void subscribe_collisions(observable<uint32_t>::Observer&& f);
+        void subscribe_decode_errors(observable<uint32_t>::Observer&& f);
+        void subscribe_door_model_error(observable<float>::Observer&& f);
+        void subscribe_door_movement(observable<DoorMovement>::Observer&& f);
 
     protected:
-        RATGDOStore isr_store_ {};
-        protocol::Protocol* protocol_;
+        void publish_changes();
+        void learn_door_motion(DoorState door_state, DoorState prev_door_state);
+        uint32_t door_motion_started();
+        void move_door_to(float position);
+        void schedule_move_stop(bool opening);
+        void correct_door_move();
+        void set_door_travel(bool opening, float travel);
+        void subscribed(bool added);
+
+        DoorMotionModel door_motion_;
+        ESPPreferenceObject door_motion_pref_;
+        uint32_t door_stop_requested_ { 0 }; // millis of the last STOP command while moving
+        uint32_t door_command_sent_ { 0 }; // millis of the last command that should start the door
+        uint32_t motor_started_ { 0 }; // millis of MOTOR_ON while the door was not moving
+        float door_move_target_ { DOOR_POSITION_UNKNOWN }; // of the move to position in progress
+        uint8_t door_move_corrections_ { 0 };
+        float position_min_delta_ { 0.01 };
+        uint32_t position_update_interval_ { 500 };
+        uint32_t position_published_at_ { 0 };
+
+        observable<uint32_t>* rolling_code_counter_ { nullptr }; // owned by the protocol
+        Callbacks<void(DoorState, float), 2> door_state_observers_;
+
+        ObstructionInput obstruction_input_;
+        ObstructionDetector obstruction_detector_;
+        GdoProtocol protocol_;
         bool obstruction_from_status_ { false };
 
         InternalGPIOPin* output_gdo_pin_;
@@ -1,9 +1,10 @@
-
 #include "secplus1.h"
 #include "ratgdo.h"
 
 #include "esphome/core/gpio.h"
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
 #include "esphome/core/scheduler.h"
 
 namespace esphome {
@@ -12,6 +13,29 @@ namespace ratgdo {
 
         static const char* const TAG = "ratgdo_secplus1";
 
+        // A wall panel polls the opener every ~250ms. Two polls close together
+        // mean there is one, a second of silence means there is none, unless
+        // it announced it is starting up, which can take up to half a minute.
+        static const uint8_t PANEL_POLLS_TO_DETECT = 2;
+        static const uint32_t PANEL_SILENCE = 1000;
+        static const uint32_t PANEL_STARTUP_TIMEOUT = 35000;
+        static const uint32_t PANEL_CHECK_INTERVAL = 100;
+        // while emulating it takes more, a stray byte must not stop us
+        static const uint8_t PANEL_POLLS_TO_STOP = 4;
+        // our own query bytes are read back, the byte we sent matches its
+        // echo for this long after it was out; the poll is only handled once
+        // the opener answered, and this is still short of the next slot
+        static const uint32_t TX_ECHO_WINDOW = 200;
+
+        // a status should arrive within a few emulation cycles once we know
+        // whether to emulate, the panel startup wait is added on top; a panel
+        // that took over from the emulation is gone after as much silence
+        static const uint32_t SYNC_TIMEOUT = 10000;
+
+        // a planned toggle is sent within ~1s and answered by the next poll
+        static const uint32_t PLAN_STEP_TIMEOUT = 5000;
+        static const uint8_t MAX_PLAN_TOGGLES = 4;
+
         void Secplus1::setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin)
         {
             this->ratgdo_ = ratgdo;
@@ -20,20 +44,44 @@ namespace ratgdo {
             this->rx_pin_ = rx_pin;
 
             this->sw_serial_.begin(1200, SWSERIAL_8E1, rx_pin->get_pin(), tx_pin->get_pin(), true);
+            this->tx_.setup(tx_pin, 1200, true);
+            this->bus_.setup(rx_pin);
 
             this->traits_.set_features(HAS_DOOR_STATUS | HAS_LIGHT_TOGGLE | HAS_LOCK_TOGGLE);
+
+            this->toggle_pref_ = global_preferences->make_preference<ToggleGraph>(ratgdo->preference_hash("ratgdo_secplus1_toggles"));
+            ToggleGraph graph;
+            if (this->toggle_pref_.load(&graph)) {
+                this->toggle_planner_.graph() = graph;
+            }
         }
 
         void Secplus1::loop()
         {
-            auto rx_cmd = this->read_command();
-            if (rx_cmd) {
+            if (this->echo_sending_ && !this->tx_.busy()) {
+                this->echo_sending_ = false;
+                this->echo_sent_at_ = millis();
+            }
+            if (!this->rx_enabled_ && !this->tx_.busy()) {
+                this->sw_serial_.enableRx(true);
+                this->rx_enabled_ = true;
+            }
+            // handle every complete packet that is already buffered
+            for (auto rx_cmd = this->read_command(); rx_cmd; rx_cmd = this->read_command()) {
                 this->handle_command(rx_cmd.value());
             }
             auto tx_cmd = this->pending_tx();
+            if (tx_cmd) {
+                this->bus_.sample();
+            }
+            this->timers_.loop();
+            if (this->emulator_.slot_due(millis())) {
+                this->emulation_slot();
+                this->emulator_.slot_done(millis());
+            }
             if (
                 (millis() - this->last_tx_) > 200 && // don't send twice in a period
-                (millis() - this->last_rx_) > 50 && // time to send it
+                this->bus_.idle_for(50000) && // time to send it
                 tx_cmd && // have pending command
                 !(this->is_0x37_panel_ && tx_cmd.value() == CommandType::TOGGLE_LOCK_PRESS) && this->wall_panel_emulation_state_ != WallPanelEmulationState::RUNNING) {
                 this->do_transmit_if_pending();
@@ -43,6 +91,21 @@ namespace ratgdo {
         void Secplus1::dump_config()
         {
             ESP_LOGCONFIG(TAG, "  Protocol: SEC+ v1");
+#if defined(USE_ESP8266)
+            // analogWrite(), tone() and servos all want timer1 too
+            ESP_LOGCONFIG(TAG, "  Transmit: %s", this->tx_.available() ? "timer1, reserved, not usable for PWM" : "blocking");
+#else
+            ESP_LOGCONFIG(TAG, "  Transmit: %s", this->tx_.available() ? "timer" : "blocking");
+#endif
+            ESP_LOGCONFIG(TAG, "  Packets received: %" PRIu32 ", sent: %" PRIu32, this->stats_.frames_received, this->stats_.frames_sent);
+            ESP_LOGCONFIG(TAG, "  Incomplete packets: %" PRIu32 ", ignored bytes: %" PRIu32 ", decode errors: %" PRIu32,
+                this->stats_.incomplete_frames, this->stats_.ignored_bytes, this->stats_.decode_errors);
+            for (uint8_t i = 0; i < COMMAND_BYTE_COUNT; i++) {
+                if (this->command_counts_[i] != 0) {
+                    uint8_t cmd = COMMAND_BYTE_FIRST + i;
+                    ESP_LOGCONFIG(TAG, "    %02X %s: %" PRIu32, cmd, CommandType_to_string(to_CommandType(cmd, CommandType::UNKNOWN)), this->command_counts_[i]);
+                }
+            }
         }
 
         void Secplus1::sync()
@@ -51,56 +114,137 @@ namespace ratgdo {
             this->wall_panel_emulation_start_ = millis();
             this->door_state = DoorState::UNKNOWN;
             this->light_state = LightState::UNKNOWN;
-            this->scheduler_->cancel_timeout(this->ratgdo_, "wall_panel_emulation");
-            this->wall_panel_emulation();
-
-            this->scheduler_->set_timeout(this->ratgdo_, "", 45000, [=] {
-                if (this->door_state == DoorState::UNKNOWN) {
-                    ESP_LOGW(TAG, "Triggering sync failed actions.");
-                    this->ratgdo_->sync_failed = true;
-                }
+            this->panel_polls_ = 0;
+            this->last_panel_poll_ = 0;
+            this->echo_byte_ = 0;
+            this->timers_.cancel(this->wall_panel_timer_);
+            this->emulator_.stop();
+            this->detect_wall_panel();
+
+            this->timers_.reset_timeout(this->sync_timer_, SYNC_TIMEOUT, [=] {
+                this->check_sync();
             });
         }
 
-        void Secplus1::wall_panel_emulation(size_t index)
+        void Secplus1::check_sync()
+        {
+            if (this->door_state != DoorState::UNKNOWN) {
+                return;
+            }
+            if (this->wall_panel_starting_ && millis() - this->wall_panel_emulation_start_ < PANEL_STARTUP_TIMEOUT + SYNC_TIMEOUT) {
+                // give a panel that is starting up its time
+                this->sync_timer_ = this->timers_.set_timeout(SYNC_TIMEOUT, [=] {
+                    this->check_sync();
+                });
+                return;
+            }
+            ESP_LOGW(TAG, "Triggering sync failed actions.");
+            this->ratgdo_->sync_failed = true;
+        }
+
+        // Classifies the bus passively from the polls we hear. Keeps
+        // listening while emulating: a panel that shows up late, or one we
+        // talked over, means we should stop polling
+        void Secplus1::observe_wall_panel(CommandType cmd)
+        {
+            if (cmd != CommandType::QUERY_DOOR_STATUS && cmd != CommandType::QUERY_OTHER_STATUS && cmd != CommandType::OBSTRUCTION) {
+                return;
+            }
+            if (this->is_echo(static_cast<uint8_t>(cmd))) {
+                return;
+            }
+            auto now = millis();
+            if (this->panel_polls_ != 0 && now - this->last_panel_poll_ < PANEL_SILENCE) {
+                this->panel_polls_ = std::min<uint8_t>(this->panel_polls_ + 1, PANEL_POLLS_TO_STOP);
+            } else {
+                this->panel_polls_ = 1;
+            }
+            this->last_panel_poll_ = now;
+
+            if (this->wall_panel_emulation_state_ == WallPanelEmulationState::RUNNING && this->panel_polls_ >= PANEL_POLLS_TO_STOP) {
+                ESP_LOGD(TAG, "Heard polls we didn't send, stopping wall panel emulation");
+                this->emulator_.stop();
+                this->wall_panel_emulation_state_ = WallPanelEmulationState::WAITING;
+                this->timers_.reset_timeout(this->wall_panel_timer_, SYNC_TIMEOUT, [=] {
+                    this->watch_wall_panel();
+                });
+            }
+        }
+
+        // Whether a poll we read is the echo of the one we sent. The echo
+        // is in the buffer by the time the frame is out, which loop() stamps,
+        // so a slow loop doesn't turn our own poll into a panel's
+        bool Secplus1::is_echo(uint8_t byte)
+        {
+            if (this->echo_byte_ == 0) {
+                return false;
+            }
+            if (!this->echo_sending_ && millis() - this->echo_sent_at_ >= TX_ECHO_WINDOW) {
+                this->echo_byte_ = 0;
+                return false;
+            }
+            if (byte != this->echo_byte_) {
+                return false;
+            }
+            this->echo_byte_ = 0;
+            return true;
+        }
+
+        // A panel took over from the emulation, go back to emulating once
+        // it has been quiet for long enough
+        void Secplus1::watch_wall_panel()
+        {
+            auto quiet = millis() - this->last_panel_poll_;
+            if (quiet < SYNC_TIMEOUT) {
+                this->wall_panel_timer_ = this->timers_.set_timeout(SYNC_TIMEOUT - quiet, [=] {
+                    this->watch_wall_panel();
+                });
+                return;
+            }
+            ESP_LOGD(TAG, "No wall panel heard for %" PRIu32 "ms. Switching back to emulation mode.", quiet);
+            this->panel_polls_ = 0;
+            this->wall_panel_emulation_state_ = WallPanelEmulationState::RUNNING;
+            this->emulator_.start(millis());
+        }
+
+        bool Secplus1::wall_panel_detected() const
+        {
+            return this->panel_polls_ >= PANEL_POLLS_TO_DETECT || this->is_0x37_panel_
+                || this->door_state != DoorState::UNKNOWN || this->light_state != LightState::UNKNOWN;
+        }
+
+        void Secplus1::detect_wall_panel()
         {
             if (this->wall_panel_emulation_state_ == WallPanelEmulationState::WAITING) {
                 ESP_LOG1(TAG, "Looking for security+ 1.0 wall panel...");
 
-                if (this->door_state != DoorState::UNKNOWN || this->light_state != LightState::UNKNOWN) {
-                    ESP_LOG1(TAG, "Wall panel detected");
+                if (this->wall_panel_detected()) {
+                    ESP_LOGD(TAG, "Wall panel detected%s", this->is_0x37_panel_ ? " (0x37)" : "");
                     return;
                 }
-                if (millis() - this->wall_panel_emulation_start_ > 35000 && !this->wall_panel_starting_) {
-                    ESP_LOG1(TAG, "No wall panel detected. Switching to emulation mode.");
+                auto now = millis();
+                auto listening = now - this->wall_panel_emulation_start_;
+                bool starting = this->wall_panel_starting_ && listening < PANEL_STARTUP_TIMEOUT;
+                if (listening >= PANEL_SILENCE && now - this->last_panel_poll_ >= PANEL_SILENCE && !starting) {
+                    ESP_LOGD(TAG, "No wall panel heard for %" PRIu32 "ms. Switching to emulation mode.", listening);
                     this->wall_panel_emulation_state_ = WallPanelEmulationState::RUNNING;
+                    this->emulator_.start(now);
+                    return;
                 }
-                this->scheduler_->set_timeout(this->ratgdo_, "wall_panel_emulation", 2000, [=] {
-                    this->wall_panel_emulation();
+                this->wall_panel_timer_ = this->timers_.set_timeout(PANEL_CHECK_INTERVAL, [=] {
+                    this->detect_wall_panel();
                 });
+            }
+        }
+
+        // One slot of the emulated wall panel: a queued command if one is due
+        // once the startup sequence is through, the next poll otherwise
+        void Secplus1::emulation_slot()
+        {
+            if (!this->emulator_.starting() && this->do_transmit_if_pending()) {
                 return;
-            } else if (this->wall_panel_emulation_state_ == WallPanelEmulationState::RUNNING) {
-                // ESP_LOG2(TAG, "[Wall panel emulation] Sending byte: [%02X]", secplus1_states[index]);
-
-                if (index < 15 || !this->do_transmit_if_pending()) {
-                    this->transmit_byte(secplus1_states[index]);
-                    // gdo response simulation for testing
-                    // auto resp = secplus1_states[index] == 0x39 ? 0x00 :
-                    //             secplus1_states[index] == 0x3A ? 0x5C :
-                    //             secplus1_states[index] == 0x38 ? 0x52 : 0xFF;
-                    // if (resp != 0xFF) {
-                    //     this->transmit_byte(resp, true);
-                    // }
-
-                    index += 1;
-                    if (index == 18) {
-                        index = 15;
-                    }
-                }
-                this->scheduler_->set_timeout(this->ratgdo_, "wall_panel_emulation", 250, [=] {
-                    this->wall_panel_emulation(index);
-                });
             }
+            this->transmit_byte(this->emulator_.next_poll());
         }
 
         void Secplus1::light_action(LightAction action)
@@ -133,55 +277,46 @@ namespace ratgdo {
             if (action == DoorAction::UNKNOWN) {
                 return;
             }
-
-            const uint32_t double_toggle_delay = 1000;
             if (action == DoorAction::TOGGLE) {
+                this->door_plan_id_++; // a manual toggle ends any plan
                 this->toggle_door();
-            } else if (action == DoorAction::OPEN) {
-                if (this->door_state == DoorState::CLOSED || this->door_state == DoorState::CLOSING) {
-                    this->toggle_door();
-                } else if (this->door_state == DoorState::STOPPED) {
-                    this->toggle_door(); // this starts closing door
-                    this->on_door_state_([=](DoorState s) {
-                        if (s == DoorState::CLOSING) {
-                            // this changes direction of the door on some openers, on others it stops it
-                            this->toggle_door();
-                            this->on_door_state_([=](DoorState s) {
-                                if (s == DoorState::STOPPED) {
-                                    this->toggle_door();
-                                }
-                            });
-                        }
-                    });
-                }
-            } else if (action == DoorAction::CLOSE) {
-                if (this->door_state == DoorState::OPEN) {
-                    this->toggle_door();
-                } else if (this->door_state == DoorState::OPENING) {
-                    this->toggle_door(); // this switches to stopped
-                    // another toggle needed to close
-                    this->on_door_state_([=](DoorState s) {
-                        if (s == DoorState::STOPPED) {
-                            this->toggle_door();
-                        }
-                    });
-                } else if (this->door_state == DoorState::STOPPED) {
-                    this->toggle_door();
+                return;
+            }
+            this->door_plan_id_++;
+            this->door_plan_toggles_ = 0;
+            this->continue_door_plan(action, this->door_state);
+        }
+
+        // Toggles once if the door isn't doing `action` yet, then waits for it
+        // to report its next state and plans again from there
+        void Secplus1::continue_door_plan(DoorAction action, DoorState door_state)
+        {
+            this->timers_.cancel(this->door_plan_timer_);
+            auto toggles = this->toggle_planner_.toggles_to(door_state, action);
+            if (toggles == 0) {
+                return;
+            }
+            if (toggles == TogglePlanner::UNREACHABLE || this->door_plan_toggles_ >= MAX_PLAN_TOGGLES) {
+                ESP_LOGW(TAG, "Don't know how to %s the door from %s", DoorAction_to_string(action), DoorState_to_string(door_state));
+                return;
+            }
+            ESP_LOG1(TAG, "Door %s: %d toggle(s) from %s", DoorAction_to_string(action), toggles, DoorState_to_string(door_state));
+            this->toggle_door();
+            this->door_plan_toggles_++;
+
+            auto id = this->door_plan_id_;
+            this->on_door_state_.clear();
+            this->on_door_state_([this, action, id](DoorState s) {
+                if (id == this->door_plan_id_) {
+                    this->continue_door_plan(action, s);
                 }
-            } else if (action == DoorAction::STOP) {
-                if (this->door_state == DoorState::OPENING) {
-                    this->toggle_door();
-                } else if (this->door_state == DoorState::CLOSING) {
-                    this->toggle_door(); // this switches to opening
-
-                    // another toggle needed to stop
-                    this->on_door_state_([=](DoorState s) {
-                        if (s == DoorState::OPENING) {
-                            this->toggle_door();
-                        }
-                    });
+            });
+            this->door_plan_timer_ = this->timers_.set_timeout(PLAN_STEP_TIMEOUT, [this, action, id] {
+                if (id == this->door_plan_id_) {
+                    ESP_LOGW(TAG, "Door did not react to the toggle, giving up on %s", DoorAction_to_string(action));
+                    this->door_plan_id_++;
                 }
-            }
+            });
         }
 
         void Secplus1::toggle_light()
@@ -205,66 +340,79 @@ namespace ratgdo {
 
         Result Secplus1::call(Args args)
         {
+            if (args.tag == Args::Tag::get_protocol_stats) {
+                return Result(ProtocolStatsRef { &this->stats_ });
+            }
             return {};
         }
 
-        optional<RxCommand> Secplus1::read_command()
+        // Reads from SoftwareSerial in chunks, returns false once both our
+        // buffer and the serial buffer are drained
+        bool Secplus1::read_byte(uint8_t& byte)
         {
-            static bool reading_msg = false;
-            static uint32_t msg_start = 0;
-            static uint16_t byte_count = 0;
-            static RxPacket rx_packet;
-
-            if (!reading_msg) {
-                while (this->sw_serial_.available()) {
-                    uint8_t ser_byte = this->sw_serial_.read();
-                    this->last_rx_ = millis();
+            if (this->rx_buffer_pos_ == this->rx_buffer_len_) {
+                int available = this->sw_serial_.available();
+                if (available <= 0) {
+                    return false;
+                }
+                this->rx_buffer_len_ = this->sw_serial_.read(this->rx_buffer_, std::min<size_t>(available, RX_BUFFER_SIZE));
+                this->rx_buffer_pos_ = 0;
+                if (this->rx_buffer_len_ == 0) {
+                    return false;
+                }
+                this->bus_.mark_activity();
+            }
+            byte = this->rx_buffer_[this->rx_buffer_pos_++];
+            return true;
+        }
 
+        optional<RxCommand> Secplus1::read_command()
+        {
+            RATGDO_PROFILE_SCOPE(this->ratgdo_->profiles.read_command);
+            uint8_t ser_byte;
+            while (this->read_byte(ser_byte)) {
+                if (!this->reading_msg_) {
                     if (ser_byte < 0x30 || ser_byte > 0x3A) {
                         ESP_LOG2(TAG, "[%d] Ignoring byte [%02X], baud: %d", millis(), ser_byte, this->sw_serial_.baudRate());
-                        byte_count = 0;
+                        this->stats_.ignored_bytes++;
+                        this->byte_count_ = 0;
                         continue;
                     }
-                    rx_packet[byte_count++] = ser_byte;
+                    this->rx_packet_[this->byte_count_++] = ser_byte;
                     ESP_LOG2(TAG, "[%d] Received byte: [%02X]", millis(), ser_byte);
-                    reading_msg = true;
+                    this->reading_msg_ = true;
 
                     if (ser_byte == 0x37 || (ser_byte >= 0x30 && ser_byte <= 0x35)) {
-                        rx_packet[byte_count++] = 0;
-                        reading_msg = false;
-                        byte_count = 0;
-                        ESP_LOG2(TAG, "[%d] Received command: [%02X]", millis(), rx_packet[0]);
-                        return this->decode_packet(rx_packet);
+                        this->rx_packet_[this->byte_count_++] = 0;
+                        this->reading_msg_ = false;
+                        this->byte_count_ = 0;
+                        ESP_LOG2(TAG, "[%d] Received command: [%02X]", millis(), this->rx_packet_[0]);
+                        return this->decode_packet(this->rx_packet_);
                     }
-
-                    break;
+                    continue;
                 }
-            }
-            if (reading_msg) {
-                while (this->sw_serial_.available()) {
-                    uint8_t ser_byte = this->sw_serial_.read();
-                    this->last_rx_ = millis();
-                    rx_packet[byte_count++] = ser_byte;
-                    ESP_LOG2(TAG, "[%d] Received byte: [%02X]", millis(), ser_byte);
 
-                    if (byte_count == RX_LENGTH) {
-                        reading_msg = false;
-                        byte_count = 0;
-                        this->print_rx_packet(rx_packet);
-                        return this->decode_packet(rx_packet);
-                    }
-                }
+                this->rx_packet_[this->byte_count_++] = ser_byte;
+                ESP_LOG2(TAG, "[%d] Received byte: [%02X]", millis(), ser_byte);
 
-                if (millis() - this->last_rx_ > 100) {
-                    // if we have a partial packet and it's been over 100ms since last byte was read,
-                    // the rest is not coming (a full packet should be received in ~20ms),
-                    // discard it so we can read the following packet correctly
-                    ESP_LOGW(TAG, "[%d] Discard incomplete packet: [%02X ...]", millis(), rx_packet[0]);
-                    reading_msg = false;
-                    byte_count = 0;
+                if (this->byte_count_ == RX_LENGTH) {
+                    this->reading_msg_ = false;
+                    this->byte_count_ = 0;
+                    this->print_rx_packet(this->rx_packet_);
+                    return this->decode_packet(this->rx_packet_);
                 }
             }
 
+            if (this->reading_msg_ && this->bus_.idle_for(100000)) {
+                // if we have a partial packet and it's been over 100ms since last byte was read,
+                // the rest is not coming (a full packet should be received in ~20ms),
+                // discard it so we can read the following packet correctly
+                ESP_LOGW(TAG, "[%d] Discard incomplete packet: [%02X ...]", millis(), this->rx_packet_[0]);
+                this->stats_.incomplete_frames++;
+                this->reading_msg_ = false;
+                this->byte_count_ = 0;
+            }
+
             return {};
         }
 
@@ -278,9 +426,14 @@ namespace ratgdo {
             ESP_LOG2(TAG, "[%d] Sending packet: [%02X %02X]", millis(), packet[0], packet[1]);
         }
 
-        optional<RxCommand> Secplus1::decode_packet(const RxPacket& packet) const
+        optional<RxCommand> Secplus1::decode_packet(const RxPacket& packet)
         {
+            this->stats_.frames_received++;
+            this->command_counts_[packet[0] - COMMAND_BYTE_FIRST]++;
             CommandType cmd_type = to_CommandType(packet[0], CommandType::UNKNOWN);
+            if (cmd_type == CommandType::UNKNOWN) {
+                this->stats_.decode_errors++;
+            }
             return RxCommand { cmd_type, packet[1] };
         }
 
@@ -293,40 +446,28 @@ namespace ratgdo {
 
         void Secplus1::handle_command(const RxCommand& cmd)
         {
+            RATGDO_PROFILE_SCOPE(this->ratgdo_->profiles.handle_command);
+            this->observe_wall_panel(cmd.req);
             if (cmd.req == CommandType::QUERY_DOOR_STATUS) {
 
-                DoorState door_state;
-                auto val = cmd.resp & 0x7;
-                // 000 0x0 stopped
-                // 001 0x1 opening
-                // 010 0x2 open
-                // 100 0x4 closing
-                // 101 0x5 closed
-                // 110 0x6 stopped
-
-                if (val == 0x2) {
-                    door_state = DoorState::OPEN;
-                } else if (val == 0x5) {
-                    door_state = DoorState::CLOSED;
-                } else if (val == 0x0 || val == 0x6) {
-                    door_state = DoorState::STOPPED;
-                } else if (val == 0x1) {
-                    door_state = DoorState::OPENING;
-                } else if (val == 0x4) {
-                    door_state = DoorState::CLOSING;
-                } else {
-                    door_state = DoorState::UNKNOWN;
-                }
+                DoorState door_state = decode_door_status(cmd.resp);
 
-                if (this->maybe_door_state != door_state) {
+                if (this->door_candidate_.value != door_state) {
                     this->on_door_state_.trigger(door_state);
                 }
 
-                if (!this->is_0x37_panel_ && door_state != this->maybe_door_state) {
-                    this->maybe_door_state = door_state;
+                bool expected = this->is_0x37_panel_ || expected_door_transition(this->door_state, door_state, this->toggled_recently(this->door_toggled_at_));
+                if (!this->door_candidate_.confirm(door_state, millis(), expected)) {
                     ESP_LOG1(TAG, "Door maybe %s, waiting for 2nd status message to confirm", DoorState_to_string(door_state));
                 } else {
-                    this->maybe_door_state = door_state;
+                    if (door_state != this->door_state) {
+                        // only the first change after our press, from the state it was sent in, answers it
+                        if (this->toggled_recently(this->door_toggled_at_) && this->door_state == this->door_toggled_from_) {
+                            this->learn_toggle(this->door_toggled_from_, door_state);
+                        }
+                        this->door_toggled_at_ = 0;
+                        this->door_toggled_from_ = DoorState::UNKNOWN;
+                    }
                     this->door_state = door_state;
                     if (this->door_state == DoorState::STOPPED || this->door_state == DoorState::OPEN || this->door_state == DoorState::CLOSED) {
                         this->door_moving_ = false;
@@ -346,19 +487,25 @@ namespace ratgdo {
                     }
                 }
             } else if (cmd.req == CommandType::QUERY_OTHER_STATUS) {
+                auto now = millis();
                 LightState light_state = to_LightState((cmd.resp >> 2) & 1, LightState::UNKNOWN);
-
-                if (!this->is_0x37_panel_ && light_state != this->maybe_light_state) {
-                    this->maybe_light_state = light_state;
-                } else {
+                bool light_expected = this->is_0x37_panel_
+                    || (this->light_state != LightState::UNKNOWN && light_state == light_state_toggle(this->light_state) && this->toggled_recently(this->light_toggled_at_));
+                if (this->light_candidate_.confirm(light_state, now, light_expected)) {
+                    if (light_state != this->light_state) {
+                        this->light_toggled_at_ = 0;
+                    }
                     this->light_state = light_state;
                     this->ratgdo_->received(light_state);
                 }
 
                 LockState lock_state = to_LockState((~cmd.resp >> 3) & 1, LockState::UNKNOWN);
-                if (!this->is_0x37_panel_ && lock_state != this->maybe_lock_state) {
-                    this->maybe_lock_state = lock_state;
-                } else {
+                bool lock_expected = this->is_0x37_panel_
+                    || (this->lock_state != LockState::UNKNOWN && lock_state == lock_state_toggle(this->lock_state) && this->toggled_recently(this->lock_toggled_at_));
+                if (this->lock_candidate_.confirm(lock_state, now, lock_expected)) {
+                    if (lock_state != this->lock_state) {
+                        this->lock_toggled_at_ = 0;
+                    }
                     this->lock_state = lock_state;
                     this->ratgdo_->received(lock_state);
                 }
@@ -388,10 +535,31 @@ namespace ratgdo {
             if (cmd) {
                 this->enqueue_command_pair(cmd.value());
                 this->transmit_byte(static_cast<uint32_t>(cmd.value()));
+                if (cmd.value() == CommandType::TOGGLE_DOOR_PRESS) {
+                    this->door_toggled_at_ = millis();
+                    this->door_toggled_from_ = this->door_state;
+                } else if (cmd.value() == CommandType::TOGGLE_LIGHT_PRESS) {
+                    this->light_toggled_at_ = millis();
+                } else if (cmd.value() == CommandType::TOGGLE_LOCK_PRESS) {
+                    this->lock_toggled_at_ = millis();
+                }
             }
             return cmd;
         }
 
+        void Secplus1::learn_toggle(DoorState from, DoorState to)
+        {
+            if (this->toggle_planner_.learn(from, to)) {
+                ESP_LOGD(TAG, "Learned: a toggle goes from %s to %s", DoorState_to_string(from), DoorState_to_string(to));
+                this->toggle_pref_.save(&this->toggle_planner_.graph());
+            }
+        }
+
+        bool Secplus1::toggled_recently(uint32_t toggled_at) const
+        {
+            return toggled_at != 0 && millis() - toggled_at < TOGGLE_RESPONSE_WINDOW;
+        }
+
         void Secplus1::enqueue_command_pair(CommandType cmd)
         {
             auto now = millis();
@@ -409,19 +577,18 @@ namespace ratgdo {
             if (time == 0) {
                 time = millis();
             }
-            this->pending_tx_.push(TxCommand { cmd, time });
+            if (!this->pending_tx_.push(TxCommand { cmd, time })) {
+                ESP_LOGE(TAG, "Transmit queue full, dropping %s", CommandType_to_string(cmd));
+            }
         }
 
         optional<CommandType> Secplus1::pending_tx()
         {
-            if (this->pending_tx_.empty()) {
-                return {};
-            }
-            auto cmd = this->pending_tx_.top();
-            if (cmd.time > millis()) {
+            auto cmd = this->pending_tx_.front();
+            if (cmd == nullptr || static_cast<int32_t>(cmd->time - millis()) > 0) {
                 return {};
             }
-            return cmd.request;
+            return cmd->request;
         }
 
         optional<CommandType> Secplus1::pop_pending_tx()
@@ -435,15 +602,37 @@ namespace ratgdo {
 
         void Secplus1::transmit_byte(uint32_t value)
         {
+            RATGDO_PROFILE_SCOPE(this->ratgdo_->profiles.transmit_packet);
             bool enable_rx = (value == 0x38) || (value == 0x39) || (value == 0x3A);
-            if (!enable_rx) {
-                this->sw_serial_.enableIntTx(false);
+            if (this->tx_.available()) {
+                // we don't want to read back anything but queries, receiving
+                // resumes from loop() once the frame is out; sends are 200ms
+                // apart, so this never overlaps a query and its response
+                if (!enable_rx && this->rx_enabled_) {
+                    this->sw_serial_.enableRx(false);
+                    this->rx_enabled_ = false;
+                }
+                if (!this->tx_.write(value)) {
+                    ESP_LOGE(TAG, "Transmit buffer full, dropping byte [%02X]", value);
+                    return;
+                }
+            } else {
+                if (!enable_rx) {
+                    this->sw_serial_.enableIntTx(false);
+                }
+                this->sw_serial_.write(value);
+                if (!enable_rx) {
+                    this->sw_serial_.enableIntTx(true);
+                }
             }
-            this->sw_serial_.write(value);
-            this->last_tx_ = millis();
-            if (!enable_rx) {
-                this->sw_serial_.enableIntTx(true);
+            if (enable_rx) {
+                this->echo_byte_ = value;
+                this->echo_sending_ = this->tx_.busy();
+                this->echo_sent_at_ = millis();
             }
+            this->last_tx_ = millis();
+            this->bus_.mark_activity();
+            this->stats_.frames_sent++;
             ESP_LOG2(TAG, "[%d] Sent byte: [%02X]", millis(), value);
         }
 
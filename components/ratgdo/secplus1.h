@@ -1,14 +1,18 @@
 #pragma once
 
-#include <queue>
-
 #include "SoftwareSerial.h" // Using espsoftwareserial https://github.com/plerup/espsoftwareserial
 #include "esphome/core/optional.h"
+#include "esphome/core/preferences.h"
 
+#include "bitbang_tx.h"
+#include "bus_monitor.h"
 #include "callbacks.h"
 #include "observable.h"
 #include "protocol.h"
 #include "ratgdo_state.h"
+#include "secplus1_state.h"
+#include "timers.h"
+#include "toggle_planner.h"
 
 namespace esphome {
 
@@ -23,6 +27,8 @@ namespace ratgdo {
         static const uint8_t RX_LENGTH = 2;
         typedef uint8_t RxPacket[RX_LENGTH];
 
+        static const uint8_t RX_BUFFER_SIZE = 16;
+
         static const uint8_t TX_LENGTH = 2;
         typedef uint8_t TxPacket[TX_LENGTH];
 
@@ -30,7 +36,10 @@ namespace ratgdo {
         static const TxPacket toggle_light = { 0x32, 0x33 };
         static const TxPacket toggle_lock = { 0x34, 0x35 };
 
-        static const uint8_t secplus1_states[] = { 0x35, 0x35, 0x35, 0x35, 0x33, 0x33, 0x53, 0x53, 0x38, 0x3A, 0x3A, 0x3A, 0x39, 0x38, 0x3A, 0x38, 0x3A, 0x39, 0x3A };
+        // what a wall panel sends after power up, then the polls it repeats
+        static const uint8_t wall_panel_startup[] = { 0x35, 0x35, 0x35, 0x35, 0x33, 0x33, 0x53, 0x53, 0x38, 0x3A, 0x3A, 0x3A, 0x39, 0x38, 0x3A };
+        static const uint8_t wall_panel_polls[] = { 0x38, 0x3A, 0x39 };
+        static const uint32_t WALL_PANEL_SLOT = 250;
 
         ENUM(CommandType, uint16_t,
             (TOGGLE_DOOR_PRESS, 0x30),
@@ -45,6 +54,10 @@ namespace ratgdo {
             (QUERY_OTHER_STATUS, 0x3A),
             (UNKNOWN, 0xFF), )
 
+        // received command bytes are in the 0x30-0x3A range
+        static const uint8_t COMMAND_BYTE_FIRST = 0x30;
+        static const uint8_t COMMAND_BYTE_COUNT = 11;
+
         struct RxCommand {
             CommandType req;
             uint8_t resp;
@@ -71,8 +84,94 @@ namespace ratgdo {
             uint32_t time;
         };
 
-        struct FirstToSend {
-            bool operator()(const TxCommand l, const TxCommand r) const { return l.time > r.time; }
+        // Pending transmits in a fixed ring, ordered by when they are due.
+        // Commands due at the same time go out in the order they were queued.
+        template <uint8_t N>
+        class TxTimeline {
+        public:
+            bool push(const TxCommand& cmd)
+            {
+                if (this->size_ == N) {
+                    return false;
+                }
+                // shift the ones due later up by one, insert in the gap
+                uint8_t pos = this->size_;
+                while (pos > 0) {
+                    const auto& prev = this->at(pos - 1);
+                    if (static_cast<int32_t>(prev.time - cmd.time) <= 0) {
+                        break;
+                    }
+                    this->at(pos) = prev;
+                    pos--;
+                }
+                this->at(pos) = cmd;
+                this->size_++;
+                return true;
+            }
+
+            const TxCommand* front() const { return this->size_ == 0 ? nullptr : &this->items_[this->head_]; }
+
+            void pop()
+            {
+                if (this->size_ != 0) {
+                    this->head_ = (this->head_ + 1) % N;
+                    this->size_--;
+                }
+            }
+
+        protected:
+            TxCommand& at(uint8_t i) { return this->items_[(this->head_ + i) % N]; }
+
+            TxCommand items_[N] {};
+            uint8_t head_ { 0 };
+            uint8_t size_ { 0 };
+        };
+
+        // press/release pairs plus status queries, with room to spare
+        static const uint8_t TX_TIMELINE_SIZE = 8;
+
+        // Plays the wall panel's part in fixed 250ms slots, polled from the
+        // loop. The schedule is fixed, so nothing is allocated or scheduled
+        // per byte, and slots stay on their cadence instead of drifting by
+        // the loop latency. A queued command goes out in the next slot once
+        // the startup sequence is through, at most 250ms later.
+        class WallPanelEmulator {
+        public:
+            void start(uint32_t now)
+            {
+                this->index_ = 0;
+                this->next_slot_ = now;
+                this->running_ = true;
+            }
+            void stop() { this->running_ = false; }
+
+            bool starting() const { return this->index_ < sizeof(wall_panel_startup); }
+            bool slot_due(uint32_t now) const { return this->running_ && static_cast<int32_t>(now - this->next_slot_) >= 0; }
+
+            uint8_t next_poll()
+            {
+                constexpr uint8_t startup = sizeof(wall_panel_startup);
+                uint8_t byte = this->index_ < startup ? wall_panel_startup[this->index_] : wall_panel_polls[this->index_ - startup];
+                this->index_++;
+                if (this->index_ == startup + sizeof(wall_panel_polls)) {
+                    this->index_ = startup;
+                }
+                return byte;
+            }
+
+            void slot_done(uint32_t now)
+            {
+                this->next_slot_ += WALL_PANEL_SLOT;
+                if (static_cast<int32_t>(now - this->next_slot_) >= 0) {
+                    // fell behind by a whole slot, don't send a burst to catch up
+                    this->next_slot_ = now + WALL_PANEL_SLOT;
+                }
+            }
+
+        protected:
+            bool running_ { false };
+            uint8_t index_ { 0 };
+            uint32_t next_slot_ { 0 };
         };
 
         enum class WallPanelEmulationState {
@@ -80,7 +179,7 @@ namespace ratgdo {
             RUNNING,
         };
 
-        class Secplus1 : public Protocol {
+        class Secplus1 {
         public:
             void setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin);
             void loop();
@@ -97,14 +196,24 @@ namespace ratgdo {
             const Traits& traits() const { return this->traits_; }
 
         protected:
-            void wall_panel_emulation(size_t index = 0);
-
+            void detect_wall_panel();
+            void emulation_slot();
+            void observe_wall_panel(CommandType cmd);
+            bool is_echo(uint8_t byte);
+            void watch_wall_panel();
+            bool wall_panel_detected() const;
+            bool toggled_recently(uint32_t toggled_at) const;
+            void learn_toggle(DoorState from, DoorState to);
+            void continue_door_plan(DoorAction action, DoorState door_state);
+            void check_sync();
+
+            bool read_byte(uint8_t& byte);
             optional<RxCommand> read_command();
             void handle_command(const RxCommand& cmd);
 
             void print_rx_packet(const RxPacket& packet) const;
             void print_tx_packet(const TxPacket& packet) const;
-            optional<RxCommand> decode_packet(const RxPacket& packet) const;
+            optional<RxCommand> decode_packet(const RxPacket& packet);
 
             void enqueue_transmit(CommandType cmd, uint32_t time = 0);
             optional<CommandType> pending_tx();
@@ -122,27 +231,61 @@ namespace ratgdo {
             LockState lock_state { LockState::UNKNOWN };
             DoorState door_state { DoorState::UNKNOWN };
 
-            LightState maybe_light_state { LightState::UNKNOWN };
-            LockState maybe_lock_state { LockState::UNKNOWN };
-            DoorState maybe_door_state { DoorState::UNKNOWN };
+            StateCandidate<LightState> light_candidate_ { LightState::UNKNOWN };
+            StateCandidate<LockState> lock_candidate_ { LockState::UNKNOWN };
+            StateCandidate<DoorState> door_candidate_ { DoorState::UNKNOWN };
+            // millis of our last toggle press of each, 0 once answered
+            uint32_t door_toggled_at_ { 0 };
+            uint32_t light_toggled_at_ { 0 };
+            uint32_t lock_toggled_at_ { 0 };
+            DoorState door_toggled_from_ { DoorState::UNKNOWN };
+
+            TogglePlanner toggle_planner_;
+            ESPPreferenceObject toggle_pref_;
+            uint8_t door_plan_id_ { 0 }; // bumped to drop the callbacks of an older plan
+            uint8_t door_plan_toggles_ { 0 };
+            TimerHandle door_plan_timer_;
 
-            OnceCallbacks<void(DoorState)> on_door_state_;
+            // the next step of the current plan, an older plan's is dropped
+            OnceCallbacks<void(DoorState), 1> on_door_state_;
 
             bool door_moving_ { false };
 
             bool wall_panel_starting_ { false };
             uint32_t wall_panel_emulation_start_ { 0 };
             WallPanelEmulationState wall_panel_emulation_state_ { WallPanelEmulationState::WAITING };
+            uint8_t panel_polls_ { 0 }; // heard close together, not sent by us
+            uint32_t last_panel_poll_ { 0 };
+            uint8_t echo_byte_ { 0 }; // the poll we sent and haven't read back yet
+            bool echo_sending_ { false };
+            uint32_t echo_sent_at_ { 0 }; // millis, when it was out
+            WallPanelEmulator emulator_;
+            TimerHandle wall_panel_timer_;
+            TimerHandle sync_timer_;
+            Timers<3> timers_;
+
+            // receive framing state
+            uint8_t rx_buffer_[RX_BUFFER_SIZE];
+            uint8_t rx_buffer_len_ { 0 };
+            uint8_t rx_buffer_pos_ { 0 };
+            bool reading_msg_ { false };
+            uint16_t byte_count_ { 0 };
+            RxPacket rx_packet_;
+
+            ProtocolStats stats_ {};
+            uint32_t command_counts_[COMMAND_BYTE_COUNT] {};
 
             bool is_0x37_panel_ { false };
-            std::priority_queue<TxCommand, std::vector<TxCommand>, FirstToSend> pending_tx_;
-            uint32_t last_rx_ { 0 };
+            TxTimeline<TX_TIMELINE_SIZE> pending_tx_;
             uint32_t last_tx_ { 0 };
+            BusMonitor bus_;
             uint32_t last_status_query_ { 0 };
 
             Traits traits_;
 
             SoftwareSerial sw_serial_;
+            BitBangTx tx_;
+            bool rx_enabled_ { true };
 
             InternalGPIOPin* tx_pin_;
             InternalGPIOPin* rx_pin_;
@@ -0,0 +1,57 @@
+#include "secplus1_state.h"
+
+namespace esphome {
+namespace ratgdo {
+    namespace secplus1 {
+
+        DoorState decode_door_status(uint8_t resp)
+        {
+            // 000 0x0 stopped
+            // 001 0x1 opening
+            // 010 0x2 open
+            // 100 0x4 closing
+            // 101 0x5 closed
+            // 110 0x6 stopped
+            switch (resp & 0x7) {
+            case 0x2:
+                return DoorState::OPEN;
+            case 0x5:
+                return DoorState::CLOSED;
+            case 0x0:
+            case 0x6:
+                return DoorState::STOPPED;
+            case 0x1:
+                return DoorState::OPENING;
+            case 0x4:
+                return DoorState::CLOSING;
+            default:
+                return DoorState::UNKNOWN;
+            }
+        }
+
+        bool expected_door_transition(DoorState from, DoorState to, bool toggled)
+        {
+            if ((from == DoorState::OPENING && to == DoorState::OPEN) || (from == DoorState::CLOSING && to == DoorState::CLOSED)) {
+                return true;
+            }
+            if (!toggled) {
+                return false;
+            }
+            switch (from) {
+            case DoorState::CLOSED:
+                return to == DoorState::OPENING;
+            case DoorState::OPEN:
+                return to == DoorState::CLOSING;
+            case DoorState::OPENING:
+                return to == DoorState::STOPPED;
+            case DoorState::CLOSING:
+            case DoorState::STOPPED:
+                return to == DoorState::OPENING || to == DoorState::CLOSING || to == DoorState::STOPPED;
+            default:
+                return false;
+            }
+        }
+
+    } // namespace secplus1
+} // namespace ratgdo
+} // namespace esphome
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ratgdo_state.h"
+
+namespace esphome {
+namespace ratgdo {
+    namespace secplus1 {
+
+        // a reported state needs a second report within this window...
+        static const uint32_t STATE_CONFIRM_WINDOW = 3000;
+        // ...unless it is the response to our own toggle sent this recently
+        static const uint32_t TOGGLE_RESPONSE_WINDOW = 2000;
+
+        // The last state reported on the bus, not yet trusted. A report is
+        // trusted when it repeats within STATE_CONFIRM_WINDOW, or right away
+        // when it is the transition we expect.
+        template <typename T>
+        struct StateCandidate {
+            T value;
+            uint32_t seen_at { 0 };
+
+            bool confirm(T state, uint32_t now, bool expected)
+            {
+                bool again = state == this->value && now - this->seen_at <= STATE_CONFIRM_WINDOW;
+                this->value = state;
+                this->seen_at = now;
+                return expected || again;
+            }
+        };
+
+        // the door state in the response to QUERY_DOOR_STATUS
+        DoorState decode_door_status(uint8_t resp);
+
+        // Whether a door report is what we'd expect next, so it needs no
+        // confirmation: the door reaching the limit it was moving to, or the
+        // opener reacting to our toggle
+        bool expected_door_transition(DoorState from, DoorState to, bool toggled);
+
+    } // namespace secplus1
+} // namespace ratgdo
+} // namespace esphome
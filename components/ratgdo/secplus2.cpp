@@ -1,10 +1,10 @@
-
 #include "secplus2.h"
 #include "ratgdo.h"
 
 #include "esphome/core/gpio.h"
 #include "esphome/core/log.h"
 #include "esphome/core/scheduler.h"
+#include <cstring>
 
 extern "C" {
 #include "secplus.h"
@@ -14,18 +14,62 @@ namespace esphome {
 namespace ratgdo {
     namespace secplus2 {
 
-        // MAX_CODES_WITHOUT_FLASH_WRITE is a bit of a guess
-        // since we write the flash at most every every 1min
-        //
-        // We want the rolling counter to be high enough that the
-        // GDO will accept the command after an unexpected reboot
-        // that did not save the counter to flash in time which
-        // results in the rolling counter being behind what the GDO
-        // expects.
+        // The rolling code counter number reserves codes ahead on flash,
+        // so after an unexpected reboot the counter should already be
+        // ahead of what the GDO expects. MAX_CODES_WITHOUT_FLASH_WRITE
+        // is the fallback when the GDO still doesn't answer, e.g. a
+        // counter saved by an older firmware or a flash write that
+        // didn't complete.
         static const uint8_t MAX_CODES_WITHOUT_FLASH_WRITE = 60;
 
         static const char* const TAG = "ratgdo_secplus2";
 
+        static const CommandType COMMAND_TYPES[] = {
+            CommandType::UNKNOWN,
+            CommandType::GET_STATUS,
+            CommandType::STATUS,
+            CommandType::OBST_1,
+            CommandType::OBST_2,
+            CommandType::BATTERY_STATUS,
+            CommandType::PAIR_3,
+            CommandType::PAIR_3_RESP,
+            CommandType::LEARN,
+            CommandType::LOCK,
+            CommandType::DOOR_ACTION,
+            CommandType::LIGHT,
+            CommandType::MOTOR_ON,
+            CommandType::MOTION,
+            CommandType::GET_PAIRED_DEVICES,
+            CommandType::PAIRED_DEVICES,
+            CommandType::CLEAR_PAIRED_DEVICES,
+            CommandType::LEARN_1,
+            CommandType::PING,
+            CommandType::PING_RESP,
+            CommandType::PAIR_2,
+            CommandType::PAIR_2_RESP,
+            CommandType::SET_TTC,
+            CommandType::CANCEL_TTC,
+            CommandType::TTC,
+            CommandType::GET_OPENINGS,
+            CommandType::OPENINGS,
+        };
+        static_assert(sizeof(COMMAND_TYPES) / sizeof(COMMAND_TYPES[0]) == COMMAND_TYPE_COUNT, "COMMAND_TYPE_COUNT out of date");
+
+        // frame start timing, all in microseconds
+        static const uint32_t BUS_IDLE_TIME = 1300;
+        static const uint32_t BREAK_TIME = 1300;
+        static const uint32_t STOP_BIT_TIME = 130;
+
+        // a door button press is released this long after it was sent
+        static const uint32_t DOOR_RELEASE_DELAY = 150;
+
+        // the GDO drops a clear that follows another too closely
+        static const uint32_t CLEAR_PAIRED_SPACING = 200;
+
+        // the GDO answers a query within ~100ms of it being sent
+        static const uint32_t QUERY_TIMEOUT = 400;
+        static const uint8_t QUERY_MAX_TRIES = 3;
+
         void Secplus2::setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin)
         {
             this->ratgdo_ = ratgdo;
@@ -34,6 +78,7 @@ namespace ratgdo {
             this->rx_pin_ = rx_pin;
 
             this->sw_serial_.begin(9600, SWSERIAL_8N1, rx_pin->get_pin(), tx_pin->get_pin(), true);
+            this->bus_.setup(rx_pin);
             this->sw_serial_.enableIntTx(false);
             this->sw_serial_.enableAutoBaud(true);
 
@@ -43,15 +88,17 @@ namespace ratgdo {
         void Secplus2::loop()
         {
             if (this->transmit_pending_) {
-                if (!this->transmit_packet()) {
-                    return;
-                }
+                this->transmit_packet();
             }
 
-            auto cmd = this->read_command();
-            if (cmd) {
+            // handle every complete packet that is already buffered
+            for (auto cmd = this->read_command(); cmd; cmd = this->read_command()) {
                 this->handle_command(*cmd);
             }
+
+            this->check_query_timeout();
+            this->timers_.loop();
+            this->door_release_timers_.loop();
         }
 
         void Secplus2::dump_config()
@@ -59,37 +106,48 @@ namespace ratgdo {
             ESP_LOGCONFIG(TAG, "  Rolling Code Counter: %d", *this->rolling_code_counter_);
             ESP_LOGCONFIG(TAG, "  Client ID: %d", this->client_id_);
             ESP_LOGCONFIG(TAG, "  Protocol: SEC+ v2");
+            ESP_LOGCONFIG(TAG, "  Packet cache hits: %" PRIu32 " echoes, %" PRIu32 " repeats", this->echo_cache_hits_, this->repeat_cache_hits_);
+            ESP_LOGCONFIG(TAG, "  Packets received: %" PRIu32 ", sent: %" PRIu32, this->stats_.frames_received, this->stats_.frames_sent);
+            ESP_LOGCONFIG(TAG, "  Incomplete packets: %" PRIu32 ", ignored bytes: %" PRIu32 ", collisions: %" PRIu32 ", decode errors: %" PRIu32,
+                this->stats_.incomplete_frames, this->stats_.ignored_bytes, this->stats_.collisions, this->stats_.decode_errors);
+            for (uint8_t i = 0; i < COMMAND_TYPE_COUNT; i++) {
+                if (this->command_counts_[i] != 0) {
+                    ESP_LOGCONFIG(TAG, "    %s: %" PRIu32, CommandType_to_string(COMMAND_TYPES[i]), this->command_counts_[i]);
+                }
+            }
         }
 
         void Secplus2::sync_helper(uint32_t start, uint32_t delay, uint8_t tries)
         {
+            // the query sequencer sends and retries these, requesting what's still unknown
+            // again is a no-op while it is pending
             bool synced = true;
             if (*this->ratgdo_->door_state == DoorState::UNKNOWN) {
-                this->query_status();
+                this->request_query(Query::STATUS);
                 synced = false;
             }
             if (*this->ratgdo_->openings == 0) {
-                this->query_openings();
+                this->request_query(Query::OPENINGS);
                 synced = false;
             }
             if (*this->ratgdo_->paired_total == PAIRED_DEVICES_UNKNOWN) {
-                this->query_paired_devices(PairedDevice::ALL);
+                this->request_query(Query::PAIRED_ALL);
                 synced = false;
             }
             if (*this->ratgdo_->paired_remotes == PAIRED_DEVICES_UNKNOWN) {
-                this->query_paired_devices(PairedDevice::REMOTE);
+                this->request_query(Query::PAIRED_REMOTE);
                 synced = false;
             }
             if (*this->ratgdo_->paired_keypads == PAIRED_DEVICES_UNKNOWN) {
-                this->query_paired_devices(PairedDevice::KEYPAD);
+                this->request_query(Query::PAIRED_KEYPAD);
                 synced = false;
             }
             if (*this->ratgdo_->paired_wall_controls == PAIRED_DEVICES_UNKNOWN) {
-                this->query_paired_devices(PairedDevice::WALL_CONTROL);
+                this->request_query(Query::PAIRED_WALL_CONTROL);
                 synced = false;
             }
             if (*this->ratgdo_->paired_accessories == PAIRED_DEVICES_UNKNOWN) {
-                this->query_paired_devices(PairedDevice::ACCESSORY);
+                this->request_query(Query::PAIRED_ACCESSORY);
                 synced = false;
             }
 
@@ -110,7 +168,7 @@ namespace ratgdo {
                 if (tries % 3 == 0) {
                     delay *= 1.5;
                 }
-                this->scheduler_->set_timeout(this->ratgdo_, "sync", delay, [=]() {
+                this->sync_timer_ = this->timers_.set_timeout(delay, [=]() {
                     this->sync_helper(start, delay, tries + 1);
                 });
             };
@@ -118,7 +176,7 @@ namespace ratgdo {
 
         void Secplus2::sync()
         {
-            this->scheduler_->cancel_timeout(this->ratgdo_, "sync");
+            this->timers_.cancel(this->sync_timer_);
             this->sync_helper(millis(), 500, 0);
         }
 
@@ -149,26 +207,40 @@ namespace ratgdo {
         Result Secplus2::call(Args args)
         {
             using Tag = Args::Tag;
-            if (args.tag == Tag::query_status) {
-                this->send_command(CommandType::GET_STATUS);
-            } else if (args.tag == Tag::query_openings) {
-                this->send_command(CommandType::GET_OPENINGS);
-            } else if (args.tag == Tag::get_rolling_code_counter) {
+            switch (args.tag) {
+            case Tag::query_status:
+                this->query_status();
+                break;
+            case Tag::query_openings:
+                this->query_openings();
+                break;
+            case Tag::get_rolling_code_counter:
                 return Result(RollingCodeCounter { std::addressof(this->rolling_code_counter_) });
-            } else if (args.tag == Tag::set_rolling_code_counter) {
+            case Tag::set_rolling_code_counter:
                 this->set_rolling_code_counter(args.value.set_rolling_code_counter.counter);
-            } else if (args.tag == Tag::set_client_id) {
+                break;
+            case Tag::set_client_id:
                 this->set_client_id(args.value.set_client_id.client_id);
-            } else if (args.tag == Tag::query_paired_devices) {
+                break;
+            case Tag::query_paired_devices:
                 this->query_paired_devices(args.value.query_paired_devices.kind);
-            } else if (args.tag == Tag::query_paired_devices_all) {
+                break;
+            case Tag::query_paired_devices_all:
                 this->query_paired_devices();
-            } else if (args.tag == Tag::clear_paired_devices) {
+                break;
+            case Tag::clear_paired_devices:
                 this->clear_paired_devices(args.value.clear_paired_devices.kind);
-            } else if (args.tag == Tag::activate_learn) {
+                break;
+            case Tag::activate_learn:
                 this->activate_learn();
-            } else if (args.tag == Tag::inactivate_learn) {
+                break;
+            case Tag::inactivate_learn:
                 this->inactivate_learn();
+                break;
+            case Tag::get_protocol_stats:
+                return Result(ProtocolStatsRef { &this->stats_ });
+            default:
+                break;
             }
             return {};
         }
@@ -176,20 +248,26 @@ namespace ratgdo {
         void Secplus2::door_command(DoorAction action)
         {
             this->send_command(Command(CommandType::DOOR_ACTION, static_cast<uint8_t>(action), 1, 1), IncrementRollingCode::NO, [=]() {
-                this->scheduler_->set_timeout(this->ratgdo_, "", 150, [=] {
+                auto release = [=] {
                     this->send_command(Command(CommandType::DOOR_ACTION, static_cast<uint8_t>(action), 0, 1));
-                });
+                };
+                auto handle = this->door_release_timers_.set_timeout(DOOR_RELEASE_DELAY, [release] { release(); });
+                if (!this->door_release_timers_.is_pending(handle)) {
+                    // the button must never stay pressed
+                    ESP_LOGE(TAG, "No timer left to release the door button, releasing now");
+                    release();
+                }
             });
         }
 
         void Secplus2::query_status()
         {
-            this->send_command(CommandType::GET_STATUS);
+            this->request_query(Query::STATUS);
         }
 
         void Secplus2::query_openings()
         {
-            this->send_command(CommandType::GET_OPENINGS);
+            this->request_query(Query::OPENINGS);
         }
 
         void Secplus2::query_paired_devices()
@@ -201,17 +279,110 @@ namespace ratgdo {
                 PairedDevice::WALL_CONTROL,
                 PairedDevice::ACCESSORY
             };
-            uint32_t timeout = 0;
             for (auto kind : kinds) {
-                timeout += 200;
-                this->scheduler_->set_timeout(this->ratgdo_, "", timeout, [=] { this->query_paired_devices(kind); });
+                this->query_paired_devices(kind);
             }
         }
 
         void Secplus2::query_paired_devices(PairedDevice kind)
         {
+            if (kind == PairedDevice::UNKNOWN) {
+                return;
+            }
             ESP_LOGD(TAG, "Query paired devices of type: %s", PairedDevice_to_string(kind));
-            this->send_command(Command { CommandType::GET_PAIRED_DEVICES, static_cast<uint8_t>(kind) });
+            this->request_query(static_cast<Query>(static_cast<uint8_t>(Query::PAIRED_ALL) + static_cast<uint8_t>(kind)));
+        }
+
+        static Command query_command(Query query)
+        {
+            if (query == Query::STATUS) {
+                return Command { CommandType::GET_STATUS };
+            } else if (query == Query::OPENINGS) {
+                return Command { CommandType::GET_OPENINGS };
+            }
+            return Command { CommandType::GET_PAIRED_DEVICES, static_cast<uint8_t>(static_cast<uint8_t>(query) - static_cast<uint8_t>(Query::PAIRED_ALL)) };
+        }
+
+        // the query a received command answers, NONE if it isn't a query response
+        static Query answered_query(const Command& cmd)
+        {
+            if (cmd.type == CommandType::STATUS) {
+                return Query::STATUS;
+            } else if (cmd.type == CommandType::OPENINGS) {
+                return Query::OPENINGS;
+            } else if (cmd.type == CommandType::PAIRED_DEVICES && cmd.nibble <= static_cast<uint8_t>(PairedDevice::ACCESSORY)) {
+                return static_cast<Query>(static_cast<uint8_t>(Query::PAIRED_ALL) + cmd.nibble);
+            }
+            return Query::NONE;
+        }
+
+        void Secplus2::request_query(Query query)
+        {
+            if (query == this->query_in_flight_) {
+                return;
+            }
+            this->queries_pending_ |= 1 << static_cast<uint8_t>(query);
+            if (this->query_in_flight_ == Query::NONE) {
+                this->send_next_query();
+            }
+        }
+
+        void Secplus2::send_next_query()
+        {
+            this->query_in_flight_ = Query::NONE;
+            if (this->queries_pending_ == 0) {
+                return;
+            }
+            uint8_t next = 0;
+            while ((this->queries_pending_ & (1 << next)) == 0) {
+                next++;
+            }
+            this->queries_pending_ &= ~(1 << next);
+            this->query_in_flight_ = static_cast<Query>(next);
+            this->query_tries_ = 0;
+            this->transmit_query();
+        }
+
+        void Secplus2::transmit_query()
+        {
+            auto query = this->query_in_flight_;
+            this->query_tries_++;
+            this->query_sent_at_ = millis();
+            // the query may wait behind other commands, the response window starts once it is on the wire
+            this->send_command(query_command(query), IncrementRollingCode::YES, [=] {
+                if (this->query_in_flight_ == query) {
+                    this->query_sent_at_ = millis();
+                }
+            });
+        }
+
+        void Secplus2::check_query_timeout()
+        {
+            if (this->query_in_flight_ == Query::NONE || millis() - this->query_sent_at_ < QUERY_TIMEOUT) {
+                return;
+            }
+            auto cmd = query_command(this->query_in_flight_);
+            if (this->query_tries_ < QUERY_MAX_TRIES) {
+                ESP_LOGD(TAG, "No response to %s (%d), retrying", CommandType_to_string(cmd.type), cmd.nibble);
+                this->transmit_query();
+            } else {
+                ESP_LOGW(TAG, "No response to %s (%d) after %d tries", CommandType_to_string(cmd.type), cmd.nibble, this->query_tries_);
+                this->send_next_query();
+            }
+        }
+
+        void Secplus2::query_answered(const Command& cmd)
+        {
+            auto query = answered_query(cmd);
+            if (query == Query::NONE) {
+                return;
+            }
+            // an unsolicited response answers a pending query just as well
+            this->queries_pending_ &= ~(1 << static_cast<uint8_t>(query));
+            if (query == this->query_in_flight_) {
+                ESP_LOG1(TAG, "Query answered in %" PRIu32 "ms", millis() - this->query_sent_at_);
+                this->send_next_query();
+            }
         }
 
         // wipe devices from memory based on get paired devices nibble values
@@ -221,19 +392,28 @@ namespace ratgdo {
                 return;
             }
             ESP_LOGW(TAG, "Clear paired devices of type: %s", PairedDevice_to_string(kind));
-            if (kind == PairedDevice::ALL) {
-                this->scheduler_->set_timeout(this->ratgdo_, "", 200, [=] { this->send_command(Command { CommandType::CLEAR_PAIRED_DEVICES, static_cast<uint8_t>(PairedDevice::REMOTE) - 1 }); }); // wireless
-                this->scheduler_->set_timeout(this->ratgdo_, "", 400, [=] { this->send_command(Command { CommandType::CLEAR_PAIRED_DEVICES, static_cast<uint8_t>(PairedDevice::KEYPAD) - 1 }); }); // keypads
-                this->scheduler_->set_timeout(this->ratgdo_, "", 600, [=] { this->send_command(Command { CommandType::CLEAR_PAIRED_DEVICES, static_cast<uint8_t>(PairedDevice::WALL_CONTROL) - 1 }); }); // wall controls
-                this->scheduler_->set_timeout(this->ratgdo_, "", 800, [=] { this->send_command(Command { CommandType::CLEAR_PAIRED_DEVICES, static_cast<uint8_t>(PairedDevice::ACCESSORY) - 1 }); }); // accessories
-                this->scheduler_->set_timeout(this->ratgdo_, "", 1000, [=] { this->query_status(); });
-                this->scheduler_->set_timeout(this->ratgdo_, "", 1200, [=] { this->query_paired_devices(); });
-            } else {
-                uint8_t dev_kind = static_cast<uint8_t>(kind) - 1;
-                this->send_command(Command { CommandType::CLEAR_PAIRED_DEVICES, dev_kind }); // just requested device
-                this->scheduler_->set_timeout(this->ratgdo_, "", 200, [=] { this->query_status(); });
-                this->scheduler_->set_timeout(this->ratgdo_, "", 400, [=] { this->query_paired_devices(kind); });
-            }
+            this->clear_paired_step(kind, kind == PairedDevice::ALL ? PairedDevice::REMOTE : kind);
+        }
+
+        // Clears `next`, then CLEAR_PAIRED_SPACING after it went out either clears the
+        // kind after it or, when done, asks for the new state
+        void Secplus2::clear_paired_step(PairedDevice kind, PairedDevice next)
+        {
+            uint8_t dev_kind = static_cast<uint8_t>(next) - 1;
+            this->send_command(Command { CommandType::CLEAR_PAIRED_DEVICES, dev_kind }, IncrementRollingCode::YES, [=] {
+                bool last = kind != PairedDevice::ALL || next == PairedDevice::ACCESSORY;
+                this->timers_.reset_timeout(this->clear_timer_, CLEAR_PAIRED_SPACING, [=] {
+                    if (last && kind == PairedDevice::ALL) {
+                        this->query_status();
+                        this->query_paired_devices();
+                    } else if (last) {
+                        this->query_status();
+                        this->query_paired_devices(kind);
+                    } else {
+                        this->clear_paired_step(kind, static_cast<PairedDevice>(static_cast<uint8_t>(next) + 1));
+                    }
+                });
+            });
         }
 
         // Learn functions
@@ -241,75 +421,95 @@ namespace ratgdo {
         {
             // Send LEARN with nibble = 0 then nibble = 1 to mimic wall control learn button
             this->send_command(Command { CommandType::LEARN, 0 });
-            this->scheduler_->set_timeout(this->ratgdo_, "", 150, [=] { this->send_command(Command { CommandType::LEARN, 1 }); });
-            this->scheduler_->set_timeout(this->ratgdo_, "", 500, [=] { this->query_status(); });
+            this->timers_.reset_timeout(this->learn_timer_, 150, [=] {
+                this->send_command(Command { CommandType::LEARN, 1 });
+                this->learn_timer_ = this->timers_.set_timeout(350, [=] { this->query_status(); });
+            });
         }
 
         void Secplus2::inactivate_learn()
         {
             // Send LEARN twice with nibble = 0 to inactivate learn and get status to update switch state
             this->send_command(Command { CommandType::LEARN, 0 });
-            this->scheduler_->set_timeout(this->ratgdo_, "", 150, [=] { this->send_command(Command { CommandType::LEARN, 0 }); });
-            this->scheduler_->set_timeout(this->ratgdo_, "", 500, [=] { this->query_status(); });
+            this->timers_.reset_timeout(this->learn_timer_, 150, [=] {
+                this->send_command(Command { CommandType::LEARN, 0 });
+                this->learn_timer_ = this->timers_.set_timeout(350, [=] { this->query_status(); });
+            });
         }
 
-        optional<Command> Secplus2::read_command()
+        // Reads from SoftwareSerial in chunks, returns false once both our
+        // buffer and the serial buffer are drained
+        bool Secplus2::read_byte(uint8_t& byte)
         {
-            static bool reading_msg = false;
-            static uint32_t msg_start = 0;
-            static uint16_t byte_count = 0;
-            static WirePacket rx_packet;
-            static uint32_t last_read = 0;
-
-            if (!reading_msg) {
-                while (this->sw_serial_.available()) {
-                    uint8_t ser_byte = this->sw_serial_.read();
-                    last_read = millis();
+            if (this->rx_buffer_pos_ == this->rx_buffer_len_) {
+                int available = this->sw_serial_.available();
+                if (available <= 0) {
+                    return false;
+                }
+                this->rx_buffer_len_ = this->sw_serial_.read(this->rx_buffer_, std::min<size_t>(available, RX_BUFFER_SIZE));
+                this->rx_buffer_pos_ = 0;
+                if (this->rx_buffer_len_ == 0) {
+                    return false;
+                }
+                this->bus_.mark_activity();
+            }
+            byte = this->rx_buffer_[this->rx_buffer_pos_++];
+            return true;
+        }
 
+        optional<Command> Secplus2::read_command()
+        {
+            RATGDO_PROFILE_SCOPE(this->ratgdo_->profiles.read_command);
+            uint8_t ser_byte;
+            while (this->read_byte(ser_byte)) {
+                if (!this->reading_msg_) {
                     if (ser_byte != 0x55 && ser_byte != 0x01 && ser_byte != 0x00) {
-                        ESP_LOG2(TAG, "Ignoring byte (%d): %02X, baud: %d", byte_count, ser_byte, this->sw_serial_.baudRate());
-                        byte_count = 0;
+                        ESP_LOG2(TAG, "Ignoring byte: %02X, baud: %d", ser_byte, this->sw_serial_.baudRate());
+                        this->stats_.ignored_bytes++;
+                        this->msg_start_ = 0;
                         continue;
                     }
-                    msg_start = ((msg_start << 8) | ser_byte) & 0xffffff;
-                    byte_count++;
+                    this->msg_start_ = ((this->msg_start_ << 8) | ser_byte) & 0xffffff;
 
                     // if we are at the start of a message, capture the next 16 bytes
-                    if (msg_start == 0x550100) {
+                    if (this->msg_start_ == 0x550100) {
                         ESP_LOG1(TAG, "Baud: %d", this->sw_serial_.baudRate());
-                        rx_packet[0] = 0x55;
-                        rx_packet[1] = 0x01;
-                        rx_packet[2] = 0x00;
-
-                        reading_msg = true;
-                        break;
+                        this->rx_packet_[0] = 0x55;
+                        this->rx_packet_[1] = 0x01;
+                        this->rx_packet_[2] = 0x00;
+                        this->byte_count_ = 3;
+                        this->msg_start_ = 0;
+                        this->reading_msg_ = true;
                     }
+                    continue;
                 }
-            }
-            if (reading_msg) {
-                while (this->sw_serial_.available()) {
-                    uint8_t ser_byte = this->sw_serial_.read();
-                    last_read = millis();
-                    rx_packet[byte_count] = ser_byte;
-                    byte_count++;
-                    // ESP_LOG2(TAG, "Received byte (%d): %02X, baud: %d", byte_count, ser_byte, this->sw_serial_.baudRate());
-
-                    if (byte_count == PACKET_LENGTH) {
-                        reading_msg = false;
-                        byte_count = 0;
-                        this->print_packet("Received packet: ", rx_packet);
-                        return this->decode_packet(rx_packet);
+
+                this->rx_packet_[this->byte_count_++] = ser_byte;
+                // ESP_LOG2(TAG, "Received byte (%d): %02X, baud: %d", this->byte_count_, ser_byte, this->sw_serial_.baudRate());
+
+                if (this->byte_count_ == PACKET_LENGTH) {
+                    this->reading_msg_ = false;
+                    this->byte_count_ = 0;
+                    this->print_packet("Received packet: ", this->rx_packet_);
+                    this->stats_.frames_received++;
+                    if (this->is_cached_packet(this->rx_packet_)) {
+                        continue;
+                    }
+                    auto cmd = this->decode_packet(this->rx_packet_);
+                    if (cmd) {
+                        return cmd;
                     }
                 }
+            }
 
-                if (millis() - last_read > 100) {
-                    // if we have a partial packet and it's been over 100ms since last byte was read,
-                    // the rest is not coming (a full packet should be received in ~20ms),
-                    // discard it so we can read the following packet correctly
-                    ESP_LOGW(TAG, "Discard incomplete packet, length: %d", byte_count);
-                    reading_msg = false;
-                    byte_count = 0;
-                }
+            if (this->reading_msg_ && this->bus_.idle_for(100000)) {
+                // if we have a partial packet and it's been over 100ms since last byte was read,
+                // the rest is not coming (a full packet should be received in ~20ms),
+                // discard it so we can read the following packet correctly
+                ESP_LOGW(TAG, "Discard incomplete packet, length: %d", this->byte_count_);
+                this->stats_.incomplete_frames++;
+                this->reading_msg_ = false;
+                this->byte_count_ = 0;
             }
 
             return {};
@@ -340,13 +540,45 @@ namespace ratgdo {
                 packet[18]);
         }
 
-        optional<Command> Secplus2::decode_packet(const WirePacket& packet) const
+        // Cheap check for packets we don't have to decode: our own transmission
+        // echoed back, or an exact repeat of a recently received packet (the
+        // rolling code changes with every new message, so equal bytes are a resend)
+        bool Secplus2::is_cached_packet(const WirePacket& packet)
+        {
+            if (memcmp(packet, this->last_tx_packet_, PACKET_LENGTH) == 0) {
+                this->echo_cache_hits_++;
+                ESP_LOG2(TAG, "Ignoring echo of our own packet");
+                return true;
+            }
+
+            auto now = millis();
+            for (auto& cached : this->rx_cache_) {
+                if (now - cached.time < RX_CACHE_WINDOW && memcmp(packet, cached.packet, PACKET_LENGTH) == 0) {
+                    this->repeat_cache_hits_++;
+                    cached.time = now;
+                    ESP_LOG2(TAG, "Ignoring repeated packet");
+                    return true;
+                }
+            }
+
+            auto& slot = this->rx_cache_[this->rx_cache_next_];
+            memcpy(slot.packet, packet, PACKET_LENGTH);
+            slot.time = now;
+            this->rx_cache_next_ = (this->rx_cache_next_ + 1) % RX_CACHE_SIZE;
+            return false;
+        }
+
+        optional<Command> Secplus2::decode_packet(const WirePacket& packet)
         {
             uint32_t rolling = 0;
             uint64_t fixed = 0;
             uint32_t data = 0;
 
-            decode_wireline(packet, &rolling, &fixed, &data);
+            if (decode_wireline(packet, &rolling, &fixed, &data) < 0) {
+                ESP_LOGW(TAG, "Failed to decode packet");
+                this->stats_.decode_errors++;
+                return {};
+            }
 
             uint16_t cmd = ((fixed >> 24) & 0xf00) | (data & 0xff);
             data &= ~0xf000; // clear parity nibble
@@ -370,8 +602,16 @@ namespace ratgdo {
 
         void Secplus2::handle_command(const Command& cmd)
         {
+            RATGDO_PROFILE_SCOPE(this->ratgdo_->profiles.handle_command);
             ESP_LOG1(TAG, "Handle command: %s", CommandType_to_string(cmd.type));
 
+            for (uint8_t i = 0; i < COMMAND_TYPE_COUNT; i++) {
+                if (COMMAND_TYPES[i] == cmd.type) {
+                    this->command_counts_[i]++;
+                    break;
+                }
+            }
+
             if (cmd.type == CommandType::STATUS) {
 
                 this->ratgdo_->received(to_DoorState(cmd.nibble, DoorState::UNKNOWN));
@@ -412,33 +652,111 @@ namespace ratgdo {
                 this->ratgdo_->received(to_BatteryState(cmd.byte1, BatteryState::UNKNOWN));
             }
 
+            this->query_answered(cmd);
+
             ESP_LOG1(TAG, "Done handle command: %s", CommandType_to_string(cmd.type));
         }
 
+        static TxPriority tx_priority(CommandType type)
+        {
+            if (type == CommandType::DOOR_ACTION) {
+                return TxPriority::DOOR;
+            } else if (type == CommandType::LIGHT || type == CommandType::LOCK) {
+                return TxPriority::ACTION;
+            }
+            return TxPriority::QUERY;
+        }
+
+        // queries that can be answered by a single response, sending them twice is pointless
+        static bool is_coalescable(CommandType type)
+        {
+            return type == CommandType::GET_STATUS || type == CommandType::GET_OPENINGS || type == CommandType::GET_PAIRED_DEVICES;
+        }
+
+        static bool same_command(const Command& a, const Command& b)
+        {
+            return a.type == b.type && a.nibble == b.nibble && a.byte1 == b.byte1 && a.byte2 == b.byte2;
+        }
+
         void Secplus2::send_command(Command command, IncrementRollingCode increment)
+        {
+            this->send_command(command, increment, nullptr);
+        }
+
+        void Secplus2::send_command(Command command, IncrementRollingCode increment, InlineFunction<void()>&& on_sent)
         {
             ESP_LOG1(TAG, "Send command: %s, data: %02X%02X%02X", CommandType_to_string(command.type), command.byte2, command.byte1, command.nibble);
-            if (!this->transmit_pending_) { // have an untransmitted packet
-                this->encode_packet(command, this->tx_packet_);
-                if (increment == IncrementRollingCode::YES) {
-                    this->increment_rolling_code_counter();
+            if (this->transmit_pending_ && this->transmit_pending_start_ == 0) {
+                ESP_LOGW(TAG, "Not connected to GDO, ignoring command: %s", CommandType_to_string(command.type));
+                return;
+            }
+            if (!this->enqueue_command(TxItem { command, increment, tx_priority(command.type), std::move(on_sent) })) {
+                return;
+            }
+            if (!this->transmit_pending_ && this->start_next_transmit()) {
+                this->transmit_packet();
+            }
+        }
+
+        bool Secplus2::enqueue_command(TxItem&& item)
+        {
+            // the caller of an item with on_sent wants to know when it's out,
+            // the one already queued or in flight wouldn't tell it
+            if (is_coalescable(item.command.type) && !item.on_sent) {
+                if (this->transmit_pending_ && same_command(this->tx_command_, item.command)) {
+                    ESP_LOG1(TAG, "Already sending, coalescing command: %s", CommandType_to_string(item.command.type));
+                    return true;
                 }
-            } else {
-                // unlikely this would happed (unless not connected to GDO), we're ensuring any pending packet
-                // is transmitted each loop before doing anyting else
-                if (this->transmit_pending_start_ > 0) {
-                    ESP_LOGW(TAG, "Have untransmitted packet, ignoring command: %s", CommandType_to_string(command.type));
-                } else {
-                    ESP_LOGW(TAG, "Not connected to GDO, ignoring command: %s", CommandType_to_string(command.type));
+                for (uint8_t i = 0; i < this->tx_queue_count_; i++) {
+                    if (same_command(this->tx_queue_at(i).command, item.command)) {
+                        ESP_LOG1(TAG, "Already queued, coalescing command: %s", CommandType_to_string(item.command.type));
+                        return true;
+                    }
                 }
             }
-            this->transmit_packet();
+
+            if (this->tx_queue_count_ == TX_QUEUE_SIZE) {
+                auto& last = this->tx_queue_at(this->tx_queue_count_ - 1);
+                if (last.priority >= item.priority) {
+                    ESP_LOGW(TAG, "Transmit queue full, ignoring command: %s", CommandType_to_string(item.command.type));
+                    return false;
+                }
+                ESP_LOGW(TAG, "Transmit queue full, dropping command: %s", CommandType_to_string(last.command.type));
+                this->tx_queue_count_--;
+            }
+
+            // keep the queue ordered by priority, FIFO within the same priority
+            uint8_t pos = this->tx_queue_count_;
+            while (pos > 0 && this->tx_queue_at(pos - 1).priority < item.priority) {
+                this->tx_queue_at(pos) = std::move(this->tx_queue_at(pos - 1));
+                pos--;
+            }
+            this->tx_queue_at(pos) = std::move(item);
+            this->tx_queue_count_++;
+            return true;
         }
 
-        void Secplus2::send_command(Command command, IncrementRollingCode increment, std::function<void()>&& on_sent)
+        // Takes the next command off the queue and encodes it, rolling code is assigned
+        // here so that the codes on the wire are always increasing in send order
+        bool Secplus2::start_next_transmit()
         {
-            this->on_command_sent_(on_sent);
-            this->send_command(command, increment);
+            if (this->tx_queue_count_ == 0) {
+                return false;
+            }
+            auto& item = this->tx_queue_at(0);
+            this->encode_packet(item.command, this->tx_packet_);
+            this->tx_command_ = item.command;
+            if (item.increment == IncrementRollingCode::YES) {
+                this->increment_rolling_code_counter();
+            }
+            this->tx_on_sent_ = std::move(item.on_sent);
+            item.on_sent = nullptr;
+            this->tx_queue_head_ = (this->tx_queue_head_ + 1) % TX_QUEUE_SIZE;
+            this->tx_queue_count_--;
+
+            this->transmit_pending_ = true;
+            this->transmit_pending_start_ = millis();
+            return true;
         }
 
         void Secplus2::encode_packet(Command command, WirePacket& packet)
@@ -451,44 +769,88 @@ namespace ratgdo {
             encode_wireline(*this->rolling_code_counter_, fixed, data, packet);
         }
 
+        // Advances the transmit state machine by at most one step and returns true
+        // once the packet has been written. Called from send_command() and every
+        // loop() while a packet is pending, so the loop never spins waiting on the bus.
         bool Secplus2::transmit_packet()
         {
+            RATGDO_PROFILE_SCOPE(this->ratgdo_->profiles.transmit_packet);
             auto now = micros();
+            bool sent = false;
+
+            if (this->transmit_state_ == TransmitState::IDLE) {
+                this->transmit_state_ = TransmitState::WAIT_BUS_IDLE;
+                this->transmit_step_start_ = now;
+                this->transmit_started_ = now;
+                this->transmit_longest_step_ = 0;
+                this->high_freq_.start();
+            }
 
-            while (micros() - now < 1300) {
-                if (this->rx_pin_->digital_read()) {
-                    if (!this->transmit_pending_) {
-                        this->transmit_pending_ = true;
-                        this->transmit_pending_start_ = millis();
-                        ESP_LOGD(TAG, "Collision detected, waiting to send packet");
-                    } else {
-                        if (millis() - this->transmit_pending_start_ < 5000) {
+            if (this->transmit_state_ == TransmitState::WAIT_BUS_IDLE) {
+                // the line must be seen idle for the whole window, and bytes
+                // still in the serial buffer are a frame we haven't read yet
+                auto idle = std::min(now - this->transmit_step_start_, now - this->bus_.last_activity());
+                if (this->bus_.sample() || this->sw_serial_.available() > 0) {
+                    // somebody is talking, the idle window restarts from now
+                    this->transmit_step_start_ = now;
+                    if (millis() - this->transmit_pending_start_ < 5000) {
+                        if (!this->transmit_collision_) {
                             ESP_LOGD(TAG, "Collision detected, waiting to send packet");
-                        } else {
-                            this->transmit_pending_start_ = 0; // to indicate GDO not connected state
+                            this->stats_.collisions++;
                         }
+                        this->transmit_collision_ = true;
+                    } else {
+                        this->transmit_pending_start_ = 0; // to indicate GDO not connected state
                     }
-                    return false;
+                } else if (idle >= BUS_IDLE_TIME) {
+                    this->transmit_collision_ = false;
+                    this->print_packet("Sending packet", this->tx_packet_);
+
+                    // indicate the start of a frame by pulling the 12V line low for at leat 1 byte followed by
+                    // one STOP bit, which indicates to the receiving end that the start of the message follows
+                    // The output pin is controlling a transistor, so the logic is inverted
+                    this->tx_pin_->digital_write(true); // pull the line low for at least 1 byte
+                    this->transmit_state_ = TransmitState::BREAK;
+                    this->transmit_step_start_ = micros();
+                }
+            } else if (this->transmit_state_ == TransmitState::BREAK) {
+                if (now - this->transmit_step_start_ >= BREAK_TIME) {
+                    this->tx_pin_->digital_write(false); // line high for at least 1 bit
+                    this->transmit_state_ = TransmitState::STOP_BIT;
+                    this->transmit_step_start_ = micros();
+                }
+            } else if (this->transmit_state_ == TransmitState::STOP_BIT) {
+                if (now - this->transmit_step_start_ >= STOP_BIT_TIME) {
+                    this->sw_serial_.write(this->tx_packet_, PACKET_LENGTH);
+                    this->bus_.mark_activity();
+                    memcpy(this->last_tx_packet_, this->tx_packet_, PACKET_LENGTH);
+                    this->stats_.frames_sent++;
+                    this->transmit_state_ = TransmitState::IDLE;
+                    sent = true;
                 }
-                delayMicroseconds(100);
             }
 
-            this->print_packet("Sending packet", this->tx_packet_);
-
-            // indicate the start of a frame by pulling the 12V line low for at leat 1 byte followed by
-            // one STOP bit, which indicates to the receiving end that the start of the message follows
-            // The output pin is controlling a transistor, so the logic is inverted
-            this->tx_pin_->digital_write(true); // pull the line low for at least 1 byte
-            delayMicroseconds(1300);
-            this->tx_pin_->digital_write(false); // line high for at least 1 bit
-            delayMicroseconds(130);
-
-            this->sw_serial_.write(this->tx_packet_, PACKET_LENGTH);
+            auto step = micros() - now;
+            if (step > this->transmit_longest_step_) {
+                this->transmit_longest_step_ = step;
+            }
 
-            this->transmit_pending_ = false;
-            this->transmit_pending_start_ = 0;
-            this->on_command_sent_.trigger();
-            return true;
+            if (sent) {
+                ESP_LOG1(TAG, "Packet sent in %" PRIu32 "us, longest blocking step: %" PRIu32 "us",
+                    micros() - this->transmit_started_, this->transmit_longest_step_);
+                auto on_sent = std::move(this->tx_on_sent_);
+                this->tx_on_sent_ = nullptr;
+                this->transmit_pending_ = false;
+                this->transmit_pending_start_ = 0;
+                // drain the queue back-to-back, the next packet only waits for the bus to be idle
+                if (!this->start_next_transmit()) {
+                    this->high_freq_.stop();
+                }
+                if (on_sent) {
+                    on_sent();
+                }
+            }
+            return sent;
         }
 
         void Secplus2::increment_rolling_code_counter(int delta)
@@ -1,13 +1,17 @@
 #pragma once
 
 #include "SoftwareSerial.h" // Using espsoftwareserial https://github.com/plerup/espsoftwareserial
+#include "esphome/core/helpers.h"
 #include "esphome/core/optional.h"
 
+#include "bus_monitor.h"
 #include "callbacks.h"
 #include "common.h"
+#include "inline_function.h"
 #include "observable.h"
 #include "protocol.h"
 #include "ratgdo_state.h"
+#include "timers.h"
 
 namespace esphome {
 
@@ -24,6 +28,18 @@ namespace ratgdo {
         static const uint8_t PACKET_LENGTH = 19;
         typedef uint8_t WirePacket[PACKET_LENGTH];
 
+        static const uint8_t RX_BUFFER_SIZE = 32;
+
+        // received packets identical to one of the last RX_CACHE_SIZE packets
+        // within RX_CACHE_WINDOW ms are repeats and are not decoded again
+        static const uint8_t RX_CACHE_SIZE = 4;
+        static const uint32_t RX_CACHE_WINDOW = 1000;
+
+        struct CachedPacket {
+            WirePacket packet;
+            uint32_t time;
+        };
+
         ENUM(CommandType, uint16_t,
             (UNKNOWN, 0x000),
             (GET_STATUS, 0x080),
@@ -58,14 +74,44 @@ namespace ratgdo {
             (OPENINGS, 0x48c), // openings = (byte1<<8)+byte2
         )
 
+        static const uint8_t COMMAND_TYPE_COUNT = 27; // number of CommandType values, for the receive histogram
+
         inline bool operator==(const uint16_t cmd_i, const CommandType& cmd_e) { return cmd_i == static_cast<uint16_t>(cmd_e); }
         inline bool operator==(const CommandType& cmd_e, const uint16_t cmd_i) { return cmd_i == static_cast<uint16_t>(cmd_e); }
 
+        enum class TransmitState {
+            IDLE,
+            WAIT_BUS_IDLE, // line must stay idle for BUS_IDLE_TIME before we start
+            BREAK, // line pulled low to mark the start of a frame
+            STOP_BIT, // line released for one bit before the payload
+        };
+
         enum class IncrementRollingCode {
             NO,
             YES,
         };
 
+        static const uint8_t TX_QUEUE_SIZE = 8;
+
+        // commands with a higher priority are sent first
+        enum class TxPriority : uint8_t {
+            QUERY,
+            ACTION, // light, lock
+            DOOR,
+        };
+
+        // queries answered by a single response, the query sequencer keeps one in flight at a time
+        enum class Query : uint8_t {
+            STATUS,
+            OPENINGS,
+            PAIRED_ALL, // PAIRED_* follow the PairedDevice order
+            PAIRED_REMOTE,
+            PAIRED_KEYPAD,
+            PAIRED_WALL_CONTROL,
+            PAIRED_ACCESSORY,
+            NONE,
+        };
+
         struct Command {
             CommandType type;
             uint8_t nibble;
@@ -85,7 +131,14 @@ namespace ratgdo {
             }
         };
 
-        class Secplus2 : public Protocol {
+        struct TxItem {
+            Command command;
+            IncrementRollingCode increment;
+            TxPriority priority;
+            InlineFunction<void()> on_sent;
+        };
+
+        class Secplus2 {
         public:
             void setup(RATGDOComponent* ratgdo, Scheduler* scheduler, InternalGPIOPin* rx_pin, InternalGPIOPin* tx_pin);
             void loop();
@@ -106,11 +159,15 @@ namespace ratgdo {
             void set_rolling_code_counter(uint32_t counter);
             void set_client_id(uint64_t client_id);
 
+            bool read_byte(uint8_t& byte);
             optional<Command> read_command();
             void handle_command(const Command& cmd);
 
             void send_command(Command cmd, IncrementRollingCode increment = IncrementRollingCode::YES);
-            void send_command(Command cmd, IncrementRollingCode increment, std::function<void()>&& on_sent);
+            void send_command(Command cmd, IncrementRollingCode increment, InlineFunction<void()>&& on_sent);
+            bool enqueue_command(TxItem&& item);
+            bool start_next_transmit();
+            TxItem& tx_queue_at(uint8_t index) { return this->tx_queue_[(this->tx_queue_head_ + index) % TX_QUEUE_SIZE]; }
             void encode_packet(Command cmd, WirePacket& packet);
             bool transmit_packet();
 
@@ -121,23 +178,74 @@ namespace ratgdo {
             void query_paired_devices();
             void query_paired_devices(PairedDevice kind);
             void clear_paired_devices(PairedDevice kind);
+            void clear_paired_step(PairedDevice kind, PairedDevice next);
+            void request_query(Query query);
+            void send_next_query();
+            void transmit_query();
+            void check_query_timeout();
+            void query_answered(const Command& cmd);
             void activate_learn();
             void inactivate_learn();
 
             void print_packet(const char* prefix, const WirePacket& packet) const;
-            optional<Command> decode_packet(const WirePacket& packet) const;
+            bool is_cached_packet(const WirePacket& packet);
+            optional<Command> decode_packet(const WirePacket& packet);
 
             void sync_helper(uint32_t start, uint32_t delay, uint8_t tries);
 
             LearnState learn_state_ { LearnState::UNKNOWN };
 
+            // receive framing state
+            uint8_t rx_buffer_[RX_BUFFER_SIZE];
+            uint8_t rx_buffer_len_ { 0 };
+            uint8_t rx_buffer_pos_ { 0 };
+            bool reading_msg_ { false };
+            uint32_t msg_start_ { 0 };
+            uint16_t byte_count_ { 0 };
+            WirePacket rx_packet_;
+
+            CachedPacket rx_cache_[RX_CACHE_SIZE] {};
+            uint8_t rx_cache_next_ { 0 };
+            WirePacket last_tx_packet_ {};
+            uint32_t echo_cache_hits_ { 0 };
+            uint32_t repeat_cache_hits_ { 0 };
+
+            ProtocolStats stats_ {};
+            uint32_t command_counts_[COMMAND_TYPE_COUNT] {};
+
             observable<uint32_t> rolling_code_counter_ { 0 };
             uint64_t client_id_ { 0x539 };
 
             bool transmit_pending_ { false };
             uint32_t transmit_pending_start_ { 0 };
+            TransmitState transmit_state_ { TransmitState::IDLE };
+            uint32_t transmit_step_start_ { 0 }; // micros
+            bool transmit_collision_ { false };
+            uint32_t transmit_started_ { 0 }; // micros
+            uint32_t transmit_longest_step_ { 0 }; // micros spent in the longest transmit_packet() call
+            HighFrequencyLoopRequester high_freq_;
+            BusMonitor bus_;
             WirePacket tx_packet_;
-            OnceCallbacks<void()> on_command_sent_;
+            Command tx_command_; // what tx_packet_ encodes
+            InlineFunction<void()> tx_on_sent_;
+
+            TxItem tx_queue_[TX_QUEUE_SIZE];
+            uint8_t tx_queue_head_ { 0 };
+            uint8_t tx_queue_count_ { 0 };
+
+            // one slot per handle, each only ever has one timeout pending;
+            // sync_helper captures its progress
+            Timers<3, 4 * sizeof(void*)> timers_;
+            TimerHandle sync_timer_;
+            TimerHandle learn_timer_;
+            TimerHandle clear_timer_;
+            // a release per press sent in the last DOOR_RELEASE_DELAY
+            Timers<4> door_release_timers_;
+
+            uint8_t queries_pending_ { 0 }; // one bit per Query
+            Query query_in_flight_ { Query::NONE };
+            uint32_t query_sent_at_ { 0 };
+            uint8_t query_tries_ { 0 };
 
             Traits traits_;
 
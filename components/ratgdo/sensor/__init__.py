@@ -18,6 +18,15 @@ TYPES = {
     "paired_devices_keypads": RATGDOSensorType.RATGDO_PAIRED_KEYPADS,
     "paired_devices_wall_controls": RATGDOSensorType.RATGDO_PAIRED_WALL_CONTROLS,
     "paired_devices_accessories": RATGDOSensorType.RATGDO_PAIRED_ACCESSORIES,
+    "frames_received": RATGDOSensorType.RATGDO_FRAMES_RECEIVED,
+    "frames_sent": RATGDOSensorType.RATGDO_FRAMES_SENT,
+    "incomplete_frames": RATGDOSensorType.RATGDO_INCOMPLETE_FRAMES,
+    "ignored_bytes": RATGDOSensorType.RATGDO_IGNORED_BYTES,
+    "collisions": RATGDOSensorType.RATGDO_COLLISIONS,
+    "decode_errors": RATGDOSensorType.RATGDO_DECODE_ERRORS,
+    "door_model_error": RATGDOSensorType.RATGDO_DOOR_MODEL_ERROR,
+    "obstruction_pulse_period": RATGDOSensorType.RATGDO_OBSTRUCTION_PULSE_PERIOD,
+    "obstruction_pulse_jitter": RATGDOSensorType.RATGDO_OBSTRUCTION_PULSE_JITTER,
 }
 
 
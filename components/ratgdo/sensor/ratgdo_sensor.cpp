@@ -33,6 +33,42 @@ namespace ratgdo {
             this->parent_->subscribe_paired_accessories([=](uint16_t value) {
                 this->publish_state(value);
             });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_FRAMES_RECEIVED) {
+            this->parent_->subscribe_frames_received([=](uint32_t value) {
+                this->publish_state(value);
+            });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_FRAMES_SENT) {
+            this->parent_->subscribe_frames_sent([=](uint32_t value) {
+                this->publish_state(value);
+            });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_INCOMPLETE_FRAMES) {
+            this->parent_->subscribe_incomplete_frames([=](uint32_t value) {
+                this->publish_state(value);
+            });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_IGNORED_BYTES) {
+            this->parent_->subscribe_ignored_bytes([=](uint32_t value) {
+                this->publish_state(value);
+            });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_COLLISIONS) {
+            this->parent_->subscribe_collisions([=](uint32_t value) {
+                this->publish_state(value);
+            });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_DECODE_ERRORS) {
+            this->parent_->subscribe_decode_errors([=](uint32_t value) {
+                this->publish_state(value);
+            });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_DOOR_MODEL_ERROR) {
+            this->parent_->subscribe_door_model_error([=](float value) {
+                this->publish_state(value);
+            });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_OBSTRUCTION_PULSE_PERIOD) {
+            this->parent_->subscribe_obstruction_pulse_period([=](float value) {
+                this->publish_state(value);
+            });
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_OBSTRUCTION_PULSE_JITTER) {
+            this->parent_->subscribe_obstruction_pulse_jitter([=](float value) {
+                this->publish_state(value);
+            });
         }
     }
 
@@ -51,6 +87,24 @@ namespace ratgdo {
             ESP_LOGCONFIG(TAG, "  Type: Paired Wall Controls");
         } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_PAIRED_ACCESSORIES) {
             ESP_LOGCONFIG(TAG, "  Type: Paired Accessories");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_FRAMES_RECEIVED) {
+            ESP_LOGCONFIG(TAG, "  Type: Frames Received");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_FRAMES_SENT) {
+            ESP_LOGCONFIG(TAG, "  Type: Frames Sent");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_INCOMPLETE_FRAMES) {
+            ESP_LOGCONFIG(TAG, "  Type: Incomplete Frames");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_IGNORED_BYTES) {
+            ESP_LOGCONFIG(TAG, "  Type: Ignored Bytes");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_COLLISIONS) {
+            ESP_LOGCONFIG(TAG, "  Type: Collisions");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_DECODE_ERRORS) {
+            ESP_LOGCONFIG(TAG, "  Type: Decode Errors");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_DOOR_MODEL_ERROR) {
+            ESP_LOGCONFIG(TAG, "  Type: Door Model Error");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_OBSTRUCTION_PULSE_PERIOD) {
+            ESP_LOGCONFIG(TAG, "  Type: Obstruction Pulse Period");
+        } else if (this->ratgdo_sensor_type_ == RATGDOSensorType::RATGDO_OBSTRUCTION_PULSE_JITTER) {
+            ESP_LOGCONFIG(TAG, "  Type: Obstruction Pulse Jitter");
         }
     }
 
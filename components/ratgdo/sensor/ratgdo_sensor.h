@@ -14,7 +14,16 @@ namespace ratgdo {
         RATGDO_PAIRED_REMOTES,
         RATGDO_PAIRED_KEYPADS,
         RATGDO_PAIRED_WALL_CONTROLS,
-        RATGDO_PAIRED_ACCESSORIES
+        RATGDO_PAIRED_ACCESSORIES,
+        RATGDO_FRAMES_RECEIVED,
+        RATGDO_FRAMES_SENT,
+        RATGDO_INCOMPLETE_FRAMES,
+        RATGDO_IGNORED_BYTES,
+        RATGDO_COLLISIONS,
+        RATGDO_DECODE_ERRORS,
+        RATGDO_DOOR_MODEL_ERROR,
+        RATGDO_OBSTRUCTION_PULSE_PERIOD,
+        RATGDO_OBSTRUCTION_PULSE_JITTER
     };
 
     class RATGDOSensor : public sensor::Sensor, public RATGDOClient, public Component {
@@ -0,0 +1,101 @@
+#pragma once
+#include <utility>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+
+#include "inline_function.h"
+
+namespace esphome {
+namespace ratgdo {
+
+    // Identifies a scheduled timeout, stays invalid once it fired or was cancelled
+    struct TimerHandle {
+        uint8_t slot { 0xff };
+        uint8_t generation { 0 };
+    };
+
+    // Fixed number of one-shot timeouts polled from the owner's loop(). Nothing
+    // is allocated and a handle can always cancel its timeout, without the risk
+    // of cancelling an unrelated one that reused the slot.
+    template <uint8_t N, size_t Size = CALLBACK_SIZE>
+    class Timers {
+    public:
+        using Callback = InlineFunction<void(), Size>;
+
+        TimerHandle set_timeout(uint32_t delay, Callback&& callback)
+        {
+            for (uint8_t i = 0; i < N; i++) {
+                auto& slot = this->slots_[i];
+                if (!slot.callback) {
+                    slot.callback = std::move(callback);
+                    slot.start = millis();
+                    slot.delay = delay;
+                    this->active_++;
+                    return TimerHandle { i, slot.generation };
+                }
+            }
+            ESP_LOGE("ratgdo", "No free timer slot out of %d, dropping timeout", N);
+            return {};
+        }
+
+        // replaces the timeout handle refers to, if still pending
+        void reset_timeout(TimerHandle& handle, uint32_t delay, Callback&& callback)
+        {
+            this->cancel(handle);
+            handle = this->set_timeout(delay, std::move(callback));
+        }
+
+        bool is_pending(TimerHandle handle) const
+        {
+            return handle.slot < N && this->slots_[handle.slot].generation == handle.generation && this->slots_[handle.slot].callback;
+        }
+
+        bool cancel(TimerHandle& handle)
+        {
+            bool pending = this->is_pending(handle);
+            if (pending) {
+                this->release(this->slots_[handle.slot]);
+            }
+            handle = {};
+            return pending;
+        }
+
+        void loop()
+        {
+            if (this->active_ == 0) {
+                return;
+            }
+            auto now = millis();
+            for (uint8_t i = 0; i < N; i++) {
+                auto& slot = this->slots_[i];
+                if (slot.callback && now - slot.start >= slot.delay) {
+                    // the callback may schedule again, free the slot first
+                    auto callback = std::move(slot.callback);
+                    this->release(slot);
+                    callback();
+                }
+            }
+        }
+
+    protected:
+        struct Slot {
+            Callback callback;
+            uint32_t start { 0 };
+            uint32_t delay { 0 };
+            uint8_t generation { 0 };
+        };
+
+        void release(Slot& slot)
+        {
+            slot.callback.reset();
+            slot.generation++;
+            this->active_--;
+        }
+
+        Slot slots_[N];
+        uint8_t active_ { 0 };
+    };
+
+} // namespace ratgdo
+} // namespace esphome
@@ -0,0 +1,77 @@
+#include "toggle_planner.h"
+
+namespace esphome {
+namespace ratgdo {
+
+    TogglePlanner::TogglePlanner()
+    {
+        for (auto& next : this->graph_.next) {
+            next = static_cast<uint8_t>(DoorState::UNKNOWN);
+        }
+        // what most openers do, until we see otherwise
+        this->graph_.next[static_cast<uint8_t>(DoorState::CLOSED)] = static_cast<uint8_t>(DoorState::OPENING);
+        this->graph_.next[static_cast<uint8_t>(DoorState::OPEN)] = static_cast<uint8_t>(DoorState::CLOSING);
+        this->graph_.next[static_cast<uint8_t>(DoorState::OPENING)] = static_cast<uint8_t>(DoorState::STOPPED);
+        this->graph_.next[static_cast<uint8_t>(DoorState::CLOSING)] = static_cast<uint8_t>(DoorState::OPENING);
+        this->graph_.next[static_cast<uint8_t>(DoorState::STOPPED)] = static_cast<uint8_t>(DoorState::CLOSING);
+    }
+
+    DoorState TogglePlanner::next(DoorState from) const
+    {
+        auto index = static_cast<uint8_t>(from);
+        if (index >= ToggleGraph::STATES) {
+            return DoorState::UNKNOWN;
+        }
+        return to_DoorState(this->graph_.next[index], DoorState::UNKNOWN);
+    }
+
+    bool TogglePlanner::learn(DoorState from, DoorState to)
+    {
+        auto index = static_cast<uint8_t>(from);
+        if (from == DoorState::UNKNOWN || to == DoorState::UNKNOWN || from == to || index >= ToggleGraph::STATES) {
+            return false;
+        }
+        // the door reaching the limit it was heading for is not the toggle's doing
+        if ((from == DoorState::OPENING && to == DoorState::OPEN) || (from == DoorState::CLOSING && to == DoorState::CLOSED)) {
+            return false;
+        }
+        if (this->graph_.next[index] == static_cast<uint8_t>(to)) {
+            return false;
+        }
+        this->graph_.next[index] = static_cast<uint8_t>(to);
+        return true;
+    }
+
+    static bool reached(DoorState state, DoorAction action)
+    {
+        switch (action) {
+        case DoorAction::OPEN:
+            return state == DoorState::OPEN || state == DoorState::OPENING;
+        case DoorAction::CLOSE:
+            return state == DoorState::CLOSED || state == DoorState::CLOSING;
+        case DoorAction::STOP:
+            return state == DoorState::STOPPED || state == DoorState::OPEN || state == DoorState::CLOSED;
+        default:
+            return false;
+        }
+    }
+
+    // Every state has a single toggle successor, so the shortest plan is
+    // the path along them; more steps than states means we're going round
+    uint8_t TogglePlanner::toggles_to(DoorState from, DoorAction action) const
+    {
+        auto state = from;
+        for (uint8_t toggles = 0; toggles < ToggleGraph::STATES; toggles++) {
+            if (reached(state, action)) {
+                return toggles;
+            }
+            state = this->next(state);
+            if (state == DoorState::UNKNOWN) {
+                break;
+            }
+        }
+        return UNREACHABLE;
+    }
+
+} // namespace ratgdo
+} // namespace esphome
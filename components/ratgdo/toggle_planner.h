@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ratgdo_state.h"
+
+namespace esphome {
+namespace ratgdo {
+
+    // The door state a single toggle leads to, from each door state,
+    // indexed by DoorState. UNKNOWN where we have no idea.
+    struct ToggleGraph {
+        static const uint8_t STATES = 6;
+        uint8_t next[STATES];
+    };
+
+    // Plans door actions for openers that only take a toggle. What a toggle
+    // does depends on the opener: from CLOSING some reverse, others stop.
+    // The graph starts from the common behaviour and is corrected by every
+    // toggle we see answered.
+    class TogglePlanner {
+    public:
+        static const uint8_t UNREACHABLE = 0xff;
+
+        TogglePlanner();
+
+        ToggleGraph& graph() { return this->graph_; }
+        DoorState next(DoorState from) const;
+
+        // a toggle from `from` got the door to `to`, true if that's news;
+        // a moving door reaching its limit is ignored, it would have anyway
+        bool learn(DoorState from, DoorState to);
+
+        // fewest toggles from `from` until the door does `action`
+        uint8_t toggles_to(DoorState from, DoorAction action) const;
+
+    protected:
+        ToggleGraph graph_;
+    };
+
+} // namespace ratgdo
+} // namespace esphome
@@ -0,0 +1,72 @@
+// Times registering and calling observers the way the component does it
+// against the std::function/std::vector code it replaced. Host numbers only
+// say which is cheaper, not by how much on an ESP8266.
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "callbacks.h"
+
+using namespace esphome::ratgdo;
+
+static const int ROUNDS = 1000000;
+
+// keeps the compiler from dropping the work
+static volatile uint32_t sink = 0;
+
+struct Entity {
+    uint32_t state { 0 };
+    void publish(uint32_t value) { this->state += value; }
+};
+
+template <typename Body>
+static double time_ns(Body body)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        body(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ROUNDS;
+}
+
+int main()
+{
+    Entity a, b;
+
+    auto std_register = time_ns([&](int) {
+        std::vector<std::function<void(uint32_t)>> observers;
+        observers.push_back([&a](uint32_t v) { a.publish(v); });
+        observers.push_back([&b](uint32_t v) { b.publish(v); });
+        sink = sink + observers.size();
+    });
+    auto inline_register = time_ns([&](int) {
+        Callbacks<void(uint32_t), 2> observers;
+        observers.add([&a](uint32_t v) { a.publish(v); });
+        observers.add([&b](uint32_t v) { b.publish(v); });
+        sink = sink + 1;
+    });
+
+    std::vector<std::function<void(uint32_t)>> std_observers;
+    std_observers.push_back([&a](uint32_t v) { a.publish(v); });
+    std_observers.push_back([&b](uint32_t v) { b.publish(v); });
+    auto std_call = time_ns([&](int i) {
+        for (auto& observer : std_observers) {
+            observer(i);
+        }
+    });
+
+    Callbacks<void(uint32_t), 2> inline_observers;
+    inline_observers.add([&a](uint32_t v) { a.publish(v); });
+    inline_observers.add([&b](uint32_t v) { b.publish(v); });
+    auto inline_call = time_ns([&](int i) { inline_observers.call(i); });
+
+    sink = sink + a.state + b.state;
+    std::printf("%-24s %10s %10s\n", "2 observers", "register", "call");
+    std::printf("%-24s %8.1fns %8.1fns\n", "std::function + vector", std_register, std_call);
+    std::printf("%-24s %8.1fns %8.1fns\n", "Callbacks", inline_register, inline_call);
+    std::printf("%-24s %10zu %10zu\n", "bytes", sizeof(std::vector<std::function<void(uint32_t)>>) + 2 * sizeof(std::function<void(uint32_t)>), sizeof(inline_observers));
+    return 0;
+}
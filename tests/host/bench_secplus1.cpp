@@ -0,0 +1,109 @@
+// Runs RATGDOComponent with Security+ 1.0 against the simulated opener and
+// measures, for each door status the opener reports, the virtual time from
+// the stop bit of its first answer to the door state observer, and the host
+// CPU time of a loop() that had bytes to read. Latency is what the protocol
+// and a 16ms loop make it, CPU only compares builds on the same machine.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+#include "secplus1_sim.h"
+
+using namespace sim;
+
+static const int CYCLES = 20;
+
+struct Latency {
+    uint32_t changes { 0 };
+    uint32_t missed { 0 };
+    uint64_t latency_total { 0 }; // us
+    uint32_t latency_max { 0 }; // us
+};
+
+// pairs every status change on the wire with the first notification of it
+static Latency measure(const Secplus1Sim& s)
+{
+    Latency r;
+    size_t n = 0;
+    for (const auto& change : s.status_changes) {
+        auto state = secplus1::decode_door_status(change.byte);
+        while (n < s.notified.size() && static_cast<int32_t>(s.notified[n].at - change.at) < 0) {
+            n++;
+        }
+        size_t found = n;
+        while (found < s.notified.size() && s.notified[found].state != state) {
+            found++;
+        }
+        if (found == s.notified.size()) {
+            r.missed++;
+            continue;
+        }
+        auto latency = s.notified[found].at - change.at;
+        r.changes++;
+        r.latency_total += latency;
+        r.latency_max = std::max(r.latency_max, latency);
+    }
+    return r;
+}
+
+static bool report(const char* name, const Secplus1Sim& s)
+{
+    auto r = measure(s);
+    std::printf("%-26s %7" PRIu32 " %9.0fms %7.0fms %9.0fns %9.0fns\n", name, r.changes,
+        r.changes ? r.latency_total / 1000.0 / r.changes : 0.0, r.latency_max / 1000.0,
+        s.busy_loops ? static_cast<double>(s.busy_ns) / s.busy_loops : 0.0,
+        s.idle_loops ? static_cast<double>(s.idle_ns) / s.idle_loops : 0.0);
+    if (r.missed != 0) {
+        std::fprintf(stderr, "%s: %" PRIu32 " door changes never reached the observers\n", name, r.missed);
+    }
+    return r.missed == 0 && r.changes > 0;
+}
+
+int main()
+{
+    bool ok = true;
+    std::printf("%-26s %7s %11s %9s %11s %11s\n", "", "changes", "latency", "max", "busy loop", "idle loop");
+
+    // somebody else's remote: every change needs a second poll to confirm
+    {
+        host_preferences.clear();
+        Secplus1Sim s(true);
+        s.run(5000);
+        for (int i = 0; i < CYCLES; i++) {
+            s.remote_press();
+            s.run(12000);
+        }
+        ok &= report("wall panel, remote", s);
+    }
+
+    // our own commands: the changes they cause are expected
+    {
+        host_preferences.clear();
+        Secplus1Sim s(true);
+        s.run(5000);
+        for (int i = 0; i < CYCLES; i++) {
+            if (i % 2 == 0) {
+                s.ratgdo.door_open();
+            } else {
+                s.ratgdo.door_close();
+            }
+            s.run(12000);
+        }
+        ok &= report("wall panel, open/close", s);
+    }
+
+    // no panel, we poll ourselves
+    {
+        host_preferences.clear();
+        Secplus1Sim s(false);
+        s.run(10000);
+        for (int i = 0; i < CYCLES; i++) {
+            s.remote_press();
+            s.run(12000);
+        }
+        ok &= report("emulated panel, remote", s);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
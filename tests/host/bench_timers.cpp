@@ -0,0 +1,125 @@
+// Times Timers against a model of a named heap scheduler, the way ESPHome's
+// set_timeout keeps its items: a heap allocated item with a std::string name
+// and a std::function, in a std::vector heap. The model is not ESPHome's
+// Scheduler, host numbers only say which is cheaper.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "timers.h"
+
+using namespace esphome;
+using namespace esphome::ratgdo;
+
+static const int ROUNDS = 1000000;
+
+// keeps the compiler from dropping the work
+static volatile uint32_t sink = 0;
+
+class HeapScheduler {
+public:
+    void set_timeout(const std::string& name, uint32_t delay, std::function<void()>&& f)
+    {
+        this->cancel(name);
+        auto item = std::unique_ptr<Item>(new Item { name, millis() + delay, std::move(f) });
+        this->items_.push_back(std::move(item));
+        std::push_heap(this->items_.begin(), this->items_.end(), compare);
+    }
+
+    bool cancel(const std::string& name)
+    {
+        auto it = std::find_if(this->items_.begin(), this->items_.end(),
+            [&name](const std::unique_ptr<Item>& item) { return item->name == name; });
+        if (it == this->items_.end()) {
+            return false;
+        }
+        this->items_.erase(it);
+        std::make_heap(this->items_.begin(), this->items_.end(), compare);
+        return true;
+    }
+
+    void loop()
+    {
+        auto now = millis();
+        while (!this->items_.empty() && (int32_t)(now - this->items_.front()->at) >= 0) {
+            std::pop_heap(this->items_.begin(), this->items_.end(), compare);
+            auto item = std::move(this->items_.back());
+            this->items_.pop_back();
+            item->f();
+        }
+    }
+
+protected:
+    struct Item {
+        std::string name;
+        uint32_t at;
+        std::function<void()> f;
+    };
+
+    static bool compare(const std::unique_ptr<Item>& a, const std::unique_ptr<Item>& b)
+    {
+        return (int32_t)(a->at - b->at) > 0;
+    }
+
+    std::vector<std::unique_ptr<Item>> items_;
+};
+
+template <typename Body>
+static double time_ns(Body body)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        body(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ROUNDS;
+}
+
+int main()
+{
+    uint32_t fired = 0;
+    host_millis = 0;
+
+    // a button press: schedule the release, it fires on a later loop
+    HeapScheduler heap;
+    auto heap_fire = time_ns([&](int i) {
+        heap.set_timeout("door_release", 150, [&fired, i] { fired += i; });
+        host_millis += 150;
+        heap.loop();
+    });
+    Timers<4> timers;
+    auto timers_fire = time_ns([&](int i) {
+        timers.set_timeout(150, [&fired, i] { fired += i; });
+        host_millis += 150;
+        timers.loop();
+    });
+
+    // a timeout pushed back before it fires, as sync and learn do
+    auto heap_reset = time_ns([&](int i) {
+        heap.set_timeout("learn", 350, [&fired, i] { fired += i; });
+    });
+    heap.cancel("learn");
+    heap.loop();
+    TimerHandle handle;
+    auto timers_reset = time_ns([&](int i) {
+        timers.reset_timeout(handle, 350, [&fired, i] { fired += i; });
+    });
+    timers.cancel(handle);
+
+    // most loops have nothing due
+    heap.set_timeout("sync", 1000000, [&fired] { fired++; });
+    auto heap_idle = time_ns([&](int) { heap.loop(); });
+    timers.set_timeout(1000000, [&fired] { fired++; });
+    auto timers_idle = time_ns([&](int) { timers.loop(); });
+
+    sink = sink + fired;
+    std::printf("%-24s %10s %10s %10s\n", "", "fire", "reset", "idle loop");
+    std::printf("%-24s %8.1fns %8.1fns %8.1fns\n", "named heap scheduler", heap_fire, heap_reset, heap_idle);
+    std::printf("%-24s %8.1fns %8.1fns %8.1fns\n", "Timers<4>", timers_fire, timers_reset, timers_idle);
+    return 0;
+}
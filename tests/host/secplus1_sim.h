@@ -0,0 +1,227 @@
+#pragma once
+// A Security+ 1.0 opener, and optionally a wall panel polling it, on the
+// other end of the loopback SoftwareSerial, running RATGDOComponent on the
+// virtual clock. The clock moves in 1ms steps, the component's loop() runs
+// every LOOP_INTERVAL like ESPHome's main loop.
+//
+// The opener answers every poll it hears, ours or the panel's, a little
+// after its stop bit. A door toggle starts the door from a limit, stops it
+// while it moves and sends a stopped door the other way. The door takes
+// TRAVEL to reach a limit.
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "SoftwareSerial.h"
+#include "esphome/core/application.h"
+#include "ratgdo.h"
+
+namespace sim {
+
+using namespace esphome;
+using namespace esphome::ratgdo;
+
+static const uint32_t LOOP_INTERVAL = 16000; // us
+static const uint32_t ANSWER_DELAY = 10000; // us, poll stop bit to answer start bit
+static const uint32_t PANEL_POLL_INTERVAL = 250000; // us
+static const uint32_t TRAVEL = 10000000; // us
+
+// status bytes of the 0x38 answer
+static const uint8_t STATUS_STOPPED = 0x00;
+static const uint8_t STATUS_OPENING = 0x01;
+static const uint8_t STATUS_OPEN = 0x02;
+static const uint8_t STATUS_CLOSING = 0x04;
+static const uint8_t STATUS_CLOSED = 0x05;
+
+struct Timed {
+    uint32_t at; // us
+    uint8_t byte;
+};
+
+struct Notified {
+    uint32_t at; // us
+    DoorState state;
+};
+
+class Secplus1Sim {
+public:
+    explicit Secplus1Sim(bool wall_panel)
+        : wall_panel_(wall_panel)
+    {
+        App.scheduler.host_clear();
+        this->rx_pin.pin = 2;
+        this->tx_pin.pin = 4;
+        this->ratgdo.set_input_gdo_pin(&this->rx_pin);
+        this->ratgdo.set_output_gdo_pin(&this->tx_pin);
+        this->ratgdo.set_input_obst_pin(nullptr);
+        this->ratgdo.subscribe_door_state([this](DoorState state, float) {
+            this->notified.push_back({ micros(), state });
+        });
+        this->ratgdo.setup();
+        this->serial_ = SoftwareSerial::host_instance;
+        this->next_loop_ = micros();
+        this->next_poll_ = micros();
+    }
+
+    // runs the bus and the component for `ms` of virtual time
+    void run(uint32_t ms)
+    {
+        auto end = micros() + ms * 1000;
+        while (static_cast<int32_t>(end - micros()) > 0) {
+            host_advance(1000);
+            this->step();
+        }
+    }
+
+    // somebody pressed a remote
+    void remote_press() { this->toggle_door(micros()); }
+
+    uint8_t status() const { return this->status_; }
+
+    // what we put on the wire, after `from`
+    std::vector<uint8_t> written(size_t from = 0) const
+    {
+        std::vector<uint8_t> bytes;
+        for (size_t i = from; i < this->serial_->host_written.size(); i++) {
+            bytes.push_back(this->serial_->host_written[i].second);
+        }
+        return bytes;
+    }
+    size_t written_count() const { return this->serial_->host_written.size(); }
+
+    InternalGPIOPin rx_pin;
+    InternalGPIOPin tx_pin;
+    RATGDOComponent ratgdo;
+
+    std::vector<Notified> notified;
+    // stop bit of each 0x38 answer that changed the status
+    std::vector<Timed> status_changes;
+
+    // host time spent in loop(), split by whether there were bytes to read
+    uint64_t busy_ns { 0 };
+    uint32_t busy_loops { 0 };
+    uint64_t idle_ns { 0 };
+    uint32_t idle_loops { 0 };
+    uint32_t packets { 0 }; // answers the component could read
+
+protected:
+    void step()
+    {
+        auto now = micros();
+        if (this->wall_panel_ && static_cast<int32_t>(now - this->next_poll_) >= 0) {
+            static const uint8_t polls[] = { 0x38, 0x3A, 0x39 };
+            this->send(polls[this->poll_index_], now);
+            this->poll_index_ = (this->poll_index_ + 1) % sizeof(polls);
+            this->next_poll_ += PANEL_POLL_INTERVAL;
+        }
+        // the opener hears whatever we sent
+        for (; this->heard_ < this->serial_->host_written.size(); this->heard_++) {
+            const auto& sent = this->serial_->host_written[this->heard_];
+            this->hear(sent.first, sent.second);
+        }
+        if (this->moving_ && static_cast<int32_t>(now - this->motion_end_) >= 0) {
+            this->moving_ = false;
+            this->status_ = this->status_ == STATUS_OPENING ? STATUS_OPEN : STATUS_CLOSED;
+        }
+        this->deliver(now);
+        if (static_cast<int32_t>(now - this->next_loop_) >= 0) {
+            this->next_loop_ += LOOP_INTERVAL;
+            this->loop();
+        }
+    }
+
+    void loop()
+    {
+        bool busy = this->serial_->available() > 0;
+        auto start = std::chrono::steady_clock::now();
+        App.scheduler.call();
+        this->ratgdo.loop();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        if (busy) {
+            this->busy_ns += ns;
+            this->busy_loops++;
+        } else {
+            this->idle_ns += ns;
+            this->idle_loops++;
+        }
+    }
+
+    // a byte somebody else puts on the wire, starting at `start`
+    void send(uint8_t byte, uint32_t start)
+    {
+        Timed frame { start + this->serial_->frame_time(), byte };
+        // in stop bit order, answers can go out before a later poll
+        auto it = this->wire_.end();
+        while (it != this->wire_.begin() && static_cast<int32_t>((it - 1)->at - frame.at) > 0) {
+            --it;
+        }
+        this->wire_.insert(it, frame);
+        this->hear(frame.at, byte);
+    }
+
+    void deliver(uint32_t now)
+    {
+        while (!this->wire_.empty() && static_cast<int32_t>(now - this->wire_.front().at) >= 0) {
+            this->serial_->host_receive(this->wire_.front().byte);
+            this->wire_.pop_front();
+        }
+        // the RX line is busy while a frame is going by
+        this->rx_pin.level = !this->wire_.empty() && static_cast<int32_t>(now - (this->wire_.front().at - this->serial_->frame_time())) >= 0;
+    }
+
+    // the opener reacts to a byte whose stop bit is at `at`
+    void hear(uint32_t at, uint8_t byte)
+    {
+        auto answer_at = at + ANSWER_DELAY;
+        if (byte == 0x38) {
+            // the status it will have by the time the answer goes out
+            if (this->moving_ && static_cast<int32_t>(answer_at - this->motion_end_) >= 0) {
+                this->moving_ = false;
+                this->status_ = this->status_ == STATUS_OPENING ? STATUS_OPEN : STATUS_CLOSED;
+            }
+            if (this->status_ != this->answered_status_) {
+                this->answered_status_ = this->status_;
+                this->status_changes.push_back({ answer_at + this->serial_->frame_time(), this->status_ });
+            }
+            this->packets++;
+            this->send(this->status_, answer_at);
+        } else if (byte == 0x39) {
+            this->packets++;
+            this->send(0x00, answer_at); // clear
+        } else if (byte == 0x3A) {
+            this->packets++;
+            this->send(0x00, answer_at); // light off, unlocked
+        } else if (byte == 0x30) {
+            this->toggle_door(at);
+        }
+    }
+
+    void toggle_door(uint32_t at)
+    {
+        if (this->moving_) {
+            this->moving_ = false;
+            this->status_ = STATUS_STOPPED;
+            return;
+        }
+        this->moving_ = true;
+        this->motion_end_ = at + TRAVEL;
+        this->status_ = this->status_ == STATUS_CLOSED ? STATUS_OPENING : STATUS_CLOSING;
+    }
+
+    bool wall_panel_;
+    SoftwareSerial* serial_ { nullptr };
+    std::deque<Timed> wire_;
+    size_t heard_ { 0 };
+    uint32_t next_loop_ { 0 };
+    uint32_t next_poll_ { 0 };
+    uint8_t poll_index_ { 0 };
+
+    uint8_t status_ { STATUS_CLOSED };
+    uint8_t answered_status_ { 0xff };
+    bool moving_ { false };
+    uint32_t motion_end_ { 0 };
+};
+
+} // namespace sim
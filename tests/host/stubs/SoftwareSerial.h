@@ -0,0 +1,83 @@
+#pragma once
+// Just enough of espsoftwareserial for the component on the host, as a
+// loopback 1200 baud bus on the virtual clock. A write blocks for the frame
+// like the real one and is read back, unless receiving or the TX interrupts
+// are off, the way the TX and RX pins share the wire to the opener. The
+// test plays the other end with host_receive() and host_written.
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "esphome/core/hal.h"
+
+enum SoftwareSerialConfig { SWSERIAL_8N1,
+    SWSERIAL_8E1 };
+
+class SoftwareSerial {
+public:
+    // the one the component began, for the test to talk to
+    static inline SoftwareSerial* host_instance = nullptr;
+
+    void begin(uint32_t baud, SoftwareSerialConfig config, int8_t, int8_t, bool)
+    {
+        this->baud_ = baud;
+        // start, data, parity if any and stop
+        this->frame_time_ = (config == SWSERIAL_8E1 ? 11 : 10) * 1000000 / baud;
+        host_instance = this;
+    }
+    void enableIntTx(bool on) { this->int_tx_ = on; }
+    void enableAutoBaud(bool) { }
+    void enableRx(bool on) { this->rx_ = on; }
+    void enableTx(bool) { }
+
+    int available() { return this->received_.size(); }
+    int read()
+    {
+        if (this->received_.empty()) {
+            return -1;
+        }
+        uint8_t byte = this->received_.front();
+        this->received_.pop_front();
+        return byte;
+    }
+    size_t read(uint8_t* buffer, size_t size)
+    {
+        size_t n = 0;
+        while (n < size && !this->received_.empty()) {
+            buffer[n++] = this->received_.front();
+            this->received_.pop_front();
+        }
+        return n;
+    }
+    size_t write(uint8_t byte)
+    {
+        esphome::host_advance(this->frame_time_);
+        this->host_written.emplace_back(esphome::micros(), byte);
+        if (this->int_tx_) {
+            this->host_receive(byte);
+        }
+        return 1;
+    }
+    uint32_t baudRate() { return this->baud_; }
+
+    // a byte whose stop bit just went by
+    void host_receive(uint8_t byte)
+    {
+        if (this->rx_) {
+            this->received_.push_back(byte);
+        }
+    }
+    uint32_t frame_time() const { return this->frame_time_; }
+
+    // micros at the stop bit and the byte, for everything we sent
+    std::vector<std::pair<uint32_t, uint8_t>> host_written;
+
+protected:
+    std::deque<uint8_t> received_;
+    uint32_t baud_ { 0 };
+    uint32_t frame_time_ { 0 };
+    bool rx_ { true };
+    bool int_tx_ { true };
+};
@@ -0,0 +1,101 @@
+// the application, scheduler and preferences behind the component stubs
+#include "esphome/core/application.h"
+#include "esphome/core/preferences.h"
+
+namespace esphome {
+Application App;
+
+std::map<uint32_t, std::vector<uint8_t>> host_preferences;
+static ESPPreferences preferences;
+ESPPreferences* global_preferences = &preferences;
+
+void Component::set_timeout(const std::string& name, uint32_t timeout, std::function<void()>&& f)
+{
+    App.scheduler.set_timeout(this, name, timeout, std::move(f));
+}
+
+void Component::set_timeout(uint32_t timeout, std::function<void()>&& f)
+{
+    App.scheduler.set_timeout(this, "", timeout, std::move(f));
+}
+
+bool Component::cancel_timeout(const std::string& name)
+{
+    return App.scheduler.cancel_timeout(this, name);
+}
+
+void Component::set_interval(const std::string& name, uint32_t interval, std::function<void()>&& f)
+{
+    App.scheduler.set_interval(this, name, interval, std::move(f));
+}
+
+bool Component::cancel_interval(const std::string& name)
+{
+    return App.scheduler.cancel_interval(this, name);
+}
+
+void Scheduler::set_timeout(Component* component, const std::string& name, uint32_t timeout, std::function<void()> f)
+{
+    this->add(Item { component, name, false, millis(), timeout, std::move(f) });
+}
+
+bool Scheduler::cancel_timeout(Component* component, const std::string& name)
+{
+    return this->cancel(component, name, false);
+}
+
+void Scheduler::set_interval(Component* component, const std::string& name, uint32_t interval, std::function<void()> f)
+{
+    this->add(Item { component, name, true, millis(), interval, std::move(f) });
+}
+
+bool Scheduler::cancel_interval(Component* component, const std::string& name)
+{
+    return this->cancel(component, name, true);
+}
+
+void Scheduler::add(Item&& item)
+{
+    this->cancel(item.component, item.name, item.interval);
+    this->items_.push_back(std::move(item));
+}
+
+bool Scheduler::cancel(Component* component, const std::string& name, bool interval)
+{
+    if (name.empty()) {
+        return false;
+    }
+    for (auto it = this->items_.begin(); it != this->items_.end(); ++it) {
+        if (it->component == component && it->interval == interval && it->name == name) {
+            this->items_.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void Scheduler::call()
+{
+    auto now = millis();
+    for (;;) {
+        // the most overdue first, a callback may add or cancel items
+        auto due = this->items_.end();
+        for (auto it = this->items_.begin(); it != this->items_.end(); ++it) {
+            int32_t left = it->start + it->delay - now;
+            if (left <= 0 && (due == this->items_.end() || static_cast<int32_t>(it->start + it->delay - (due->start + due->delay)) < 0)) {
+                due = it;
+            }
+        }
+        if (due == this->items_.end()) {
+            return;
+        }
+        auto f = due->f;
+        if (due->interval) {
+            due->start += due->delay;
+        } else {
+            this->items_.erase(due);
+        }
+        f();
+    }
+}
+}
@@ -0,0 +1,17 @@
+// the clocks behind the hal.h stub
+#include "esphome/core/hal.h"
+
+namespace esphome {
+uint32_t host_millis = 0;
+uint32_t host_micros = 0;
+
+// keeps millis() in step with micros(), carrying the part of a ms
+void host_advance(uint32_t us)
+{
+    static uint32_t carry = 0;
+    carry += us;
+    host_micros += us;
+    host_millis += carry / 1000;
+    carry %= 1000;
+}
+}
@@ -0,0 +1,12 @@
+#pragma once
+// just enough of esphome/core/application.h for the component on the host
+#include "esphome/core/scheduler.h"
+
+namespace esphome {
+class Application {
+public:
+    Scheduler scheduler;
+};
+
+extern Application App;
+}
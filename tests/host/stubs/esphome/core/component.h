@@ -0,0 +1,31 @@
+#pragma once
+// just enough of esphome/core/component.h for the component on the host,
+// timeouts go through App.scheduler
+#include <functional>
+#include <string>
+
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/optional.h"
+
+namespace esphome {
+class Component {
+public:
+    virtual ~Component() = default;
+    virtual void setup() { }
+    virtual void loop() { }
+    virtual void dump_config() { }
+
+    virtual void mark_failed() { this->failed_ = true; }
+    bool is_failed() const { return this->failed_; }
+
+protected:
+    void set_timeout(const std::string& name, uint32_t timeout, std::function<void()>&& f);
+    void set_timeout(uint32_t timeout, std::function<void()>&& f);
+    bool cancel_timeout(const std::string& name);
+    void set_interval(const std::string& name, uint32_t interval, std::function<void()>&& f);
+    bool cancel_interval(const std::string& name);
+
+    bool failed_ { false };
+};
+}
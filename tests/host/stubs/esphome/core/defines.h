@@ -0,0 +1,2 @@
+#pragma once
+// the protocol comes from the Makefile, as it would from the YAML
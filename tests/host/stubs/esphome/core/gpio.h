@@ -0,0 +1,35 @@
+#pragma once
+// just enough of esphome/core/gpio.h for the component on the host,
+// the pin is a level the test sets
+#include <cstdint>
+
+namespace esphome {
+namespace gpio {
+    enum Flags : uint8_t { FLAG_NONE = 0, FLAG_INPUT = 1, FLAG_OUTPUT = 2, FLAG_PULLUP = 4 };
+    inline Flags operator|(Flags a, Flags b) { return static_cast<Flags>(static_cast<uint8_t>(a) | static_cast<uint8_t>(b)); }
+    enum InterruptType { INTERRUPT_RISING_EDGE = 1, INTERRUPT_FALLING_EDGE = 2, INTERRUPT_ANY_EDGE = 3 };
+}
+
+class ISRInternalGPIOPin {
+public:
+    void digital_write(bool value) { this->level = value; }
+    bool digital_read() { return this->level; }
+    bool level { false };
+};
+
+class InternalGPIOPin {
+public:
+    void setup() { }
+    void pin_mode(gpio::Flags) { }
+    bool digital_read() { return this->level; }
+    void digital_write(bool value) { this->level = value; }
+    uint8_t get_pin() const { return this->pin; }
+    ISRInternalGPIOPin to_isr() const { return {}; }
+    template <typename T>
+    void attach_interrupt(void (*)(T*), T*, gpio::InterruptType) const { }
+    bool level { false };
+    uint8_t pin { 0 };
+};
+}
+
+#define LOG_PIN(prefix, pin) ESP_LOGCONFIG(TAG, prefix "GPIO%u", (pin)->get_pin())
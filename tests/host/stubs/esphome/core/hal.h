@@ -0,0 +1,15 @@
+#pragma once
+// just enough of esphome/core/hal.h for the helper headers on the host,
+// the tests move the clocks by hand, or both at once with host_advance()
+#include <cstdint>
+
+#define IRAM_ATTR
+#define HOT
+
+namespace esphome {
+extern uint32_t host_millis;
+extern uint32_t host_micros;
+inline uint32_t millis() { return host_millis; }
+inline uint32_t micros() { return host_micros; }
+void host_advance(uint32_t us);
+}
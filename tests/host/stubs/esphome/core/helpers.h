@@ -0,0 +1,37 @@
+#pragma once
+// just enough of esphome/core/helpers.h for the component on the host
+#include <cmath>
+#include <string>
+
+#include "esphome/core/hal.h"
+
+namespace esphome {
+// nothing interrupts the host tests
+class InterruptLock {
+public:
+    InterruptLock() { }
+    ~InterruptLock() { }
+};
+
+template <typename T>
+const T& clamp(const T& v, const T& lo, const T& hi) { return v < lo ? lo : (hi < v ? hi : v); }
+
+template <typename T>
+class Parented {
+public:
+    void set_parent(T* parent) { this->parent_ = parent; }
+
+protected:
+    T* parent_ { nullptr };
+};
+
+inline uint32_t fnv1_hash(const std::string& str)
+{
+    uint32_t hash = 2166136261UL;
+    for (char c : str) {
+        hash *= 16777619UL;
+        hash ^= c;
+    }
+    return hash;
+}
+}
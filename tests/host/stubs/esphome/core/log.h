@@ -0,0 +1,17 @@
+#pragma once
+// just enough of esphome/core/log.h for the component on the host: errors
+// and warnings go to stderr, the rest is dropped after its arguments were
+// evaluated, like a build that logs at WARN
+#include <cstdio>
+
+namespace esphome {
+template <typename... Args>
+inline void host_log_drop(const char*, Args&&...) { }
+}
+
+#define ESP_LOGE(tag, ...) (std::fprintf(stderr, "[E][%s] ", tag), std::fprintf(stderr, __VA_ARGS__), std::fputc('\n', stderr))
+#define ESP_LOGW(tag, ...) (std::fprintf(stderr, "[W][%s] ", tag), std::fprintf(stderr, __VA_ARGS__), std::fputc('\n', stderr))
+#define ESP_LOGI(tag, ...) esphome::host_log_drop(__VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) esphome::host_log_drop(__VA_ARGS__)
+#define ESP_LOGD(tag, ...) esphome::host_log_drop(__VA_ARGS__)
+#define ESP_LOGV(tag, ...) esphome::host_log_drop(__VA_ARGS__)
@@ -0,0 +1,12 @@
+#pragma once
+// just enough of esphome/core/optional.h, which converts to bool implicitly
+#include <optional>
+
+namespace esphome {
+template <typename T>
+class optional : public std::optional<T> {
+public:
+    using std::optional<T>::optional;
+    operator bool() const { return this->has_value(); }
+};
+}
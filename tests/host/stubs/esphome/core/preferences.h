@@ -0,0 +1,55 @@
+#pragma once
+// just enough of esphome/core/preferences.h, kept in memory for the whole
+// run so a second component sees what the first one saved
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace esphome {
+extern std::map<uint32_t, std::vector<uint8_t>> host_preferences;
+
+class ESPPreferenceObject {
+public:
+    ESPPreferenceObject() = default;
+    explicit ESPPreferenceObject(uint32_t key)
+        : key_(key)
+        , valid_(true)
+    {
+    }
+
+    template <typename T>
+    bool save(const T* src)
+    {
+        if (!this->valid_) {
+            return false;
+        }
+        auto bytes = reinterpret_cast<const uint8_t*>(src);
+        host_preferences[this->key_].assign(bytes, bytes + sizeof(T));
+        return true;
+    }
+
+    template <typename T>
+    bool load(T* dest)
+    {
+        auto it = host_preferences.find(this->key_);
+        if (!this->valid_ || it == host_preferences.end() || it->second.size() != sizeof(T)) {
+            return false;
+        }
+        std::memcpy(static_cast<void*>(dest), it->second.data(), sizeof(T));
+        return true;
+    }
+
+protected:
+    uint32_t key_ { 0 };
+    bool valid_ { false };
+};
+
+class ESPPreferences {
+public:
+    template <typename T>
+    ESPPreferenceObject make_preference(uint32_t type, bool = false) { return ESPPreferenceObject(type); }
+};
+
+extern ESPPreferences* global_preferences;
+}
@@ -0,0 +1,37 @@
+#pragma once
+// A plain version of ESPHome's Scheduler on the virtual clock: a named
+// timeout or interval replaces the one of the same component and name,
+// call() runs whatever is due in the order it is due
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "esphome/core/component.h"
+
+namespace esphome {
+class Scheduler {
+public:
+    void set_timeout(Component* component, const std::string& name, uint32_t timeout, std::function<void()> f);
+    bool cancel_timeout(Component* component, const std::string& name);
+    void set_interval(Component* component, const std::string& name, uint32_t interval, std::function<void()> f);
+    bool cancel_interval(Component* component, const std::string& name);
+    void call();
+    // drops everything, for the next test's component
+    void host_clear() { this->items_.clear(); }
+
+protected:
+    struct Item {
+        Component* component;
+        std::string name;
+        bool interval;
+        uint32_t start;
+        uint32_t delay;
+        std::function<void()> f;
+    };
+
+    void add(Item&& item);
+    bool cancel(Component* component, const std::string& name, bool interval);
+
+    std::vector<Item> items_;
+};
+}
@@ -0,0 +1,174 @@
+// Checks the helpers behave like the std::function/std::vector code they
+// replaced, plus the edges that code didn't have: full slots and reentry.
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#include "callbacks.h"
+#include "inline_function.h"
+#include "observable.h"
+#include "timers.h"
+
+using namespace esphome;
+using namespace esphome::ratgdo;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static void test_inline_function()
+{
+    int calls = 0;
+    InlineFunction<int(int)> f = [&calls](int x) { calls++; return x * 2; };
+    CHECK(f);
+    CHECK(f(21) == 42);
+
+    // moving leaves the source empty
+    InlineFunction<int(int)> g = std::move(f);
+    CHECK(!f);
+    CHECK(g(1) == 2);
+    CHECK(calls == 2);
+
+    // captures are destroyed exactly once, on reset or when replaced
+    auto owned = std::make_shared<int>(0);
+    {
+        InlineFunction<void()> h = [owned] { };
+        CHECK(owned.use_count() == 2);
+        InlineFunction<void()> moved = std::move(h);
+        CHECK(owned.use_count() == 2);
+        moved = [] { };
+        CHECK(owned.use_count() == 1);
+    }
+    CHECK(owned.use_count() == 1);
+}
+
+static void test_callbacks_full()
+{
+    Callbacks<void(int), 2> callbacks;
+    int sum = 0;
+    CHECK(callbacks.add([&sum](int x) { sum += x; }));
+    CHECK(callbacks.add([&sum](int x) { sum += 10 * x; }));
+    // the third has no slot, the caller is told
+    CHECK(!callbacks.add([&sum](int x) { sum += 100 * x; }));
+    callbacks.call(1);
+    CHECK(sum == 11);
+}
+
+static void test_callbacks_clear()
+{
+    // a newer callback replacing the pending one, as the door commands do
+    OnceCallbacks<void(int), 1> once;
+    auto owned = std::make_shared<int>(0);
+    int fired = 0;
+    CHECK(once.add([owned](int) { }));
+    CHECK(owned.use_count() == 2);
+    once.clear();
+    CHECK(owned.use_count() == 1);
+    CHECK(once.add([&fired](int x) { fired = x; }));
+    once.trigger(7);
+    CHECK(fired == 7);
+}
+
+static void test_once_callbacks_reentry()
+{
+    struct {
+        OnceCallbacks<void(int), 2> once;
+        int first = 0;
+        int second = 0;
+    } t;
+    t.once([&t](int x) {
+        t.first = x;
+        // registering from a callback waits for the next trigger
+        t.once([&t](int y) { t.second = y; });
+    });
+    t.once.trigger(1);
+    CHECK(t.first == 1);
+    CHECK(t.second == 0);
+    t.once.trigger(2);
+    CHECK(t.first == 1);
+    CHECK(t.second == 2);
+    t.once.trigger(3);
+    CHECK(t.second == 2);
+}
+
+static void test_observable()
+{
+    observable<int> value { 0 };
+    int seen = -1;
+    int calls = 0;
+    CHECK(value.subscribe([&](int v) { seen = v; calls++; }));
+    CHECK(value.subscribe([](int) { }));
+    CHECK(!value.subscribe([](int) { }));
+
+    // observers get the latest value, once per flush, only after a change
+    value = 1;
+    value = 2;
+    value.flush();
+    CHECK(seen == 2);
+    CHECK(calls == 1);
+    value.flush();
+    CHECK(calls == 1);
+    value = 2;
+    value.flush();
+    CHECK(calls == 1);
+}
+
+static void test_timers()
+{
+    Timers<2> timers;
+    int fired = 0;
+    host_millis = 1000;
+    auto a = timers.set_timeout(10, [&fired] { fired |= 1; });
+    auto b = timers.set_timeout(20, [&fired] { fired |= 2; });
+    CHECK(timers.is_pending(a));
+    CHECK(timers.is_pending(b));
+
+    host_millis = 1010;
+    timers.loop();
+    CHECK(fired == 1);
+    CHECK(!timers.is_pending(a));
+
+    // the handle of a fired timer can't cancel the one that reused its slot
+    auto c = timers.set_timeout(5, [&fired] { fired |= 4; });
+    CHECK(c.slot == a.slot);
+    CHECK(!timers.cancel(a));
+    CHECK(timers.is_pending(c));
+
+    CHECK(timers.cancel(b));
+    host_millis = 1100;
+    timers.loop();
+    CHECK(fired == 5);
+
+    // a full table hands out a handle that is never pending, callers that
+    // can't lose the timeout check it
+    timers.set_timeout(10, [] { });
+    timers.set_timeout(10, [] { });
+    auto dropped = timers.set_timeout(10, [&fired] { fired |= 8; });
+    CHECK(!timers.is_pending(dropped));
+    host_millis = 1200;
+    timers.loop();
+    CHECK(fired == 5);
+}
+
+int main()
+{
+    test_inline_function();
+    test_callbacks_full();
+    test_callbacks_clear();
+    test_once_callbacks_reentry();
+    test_observable();
+    test_timers();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("all passed\n");
+    return EXIT_SUCCESS;
+}
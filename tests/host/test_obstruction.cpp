@@ -0,0 +1,160 @@
+// Runs ObstructionDetector against a simulated obstruction sensor: pulses
+// every 7ms while clear, the line held high while obstructed and low while
+// asleep. Pulses come either through ObstructionStore's ISR, like the
+// interrupt input, or as bare counts stamped at read time, like the ESP32
+// pulse counter.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "obstruction.h"
+
+using namespace esphome;
+using namespace esphome::ratgdo;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static const uint32_t PULSE_PERIOD = 7000; // us
+static const uint32_t LOOP_PERIOD = 16000; // us, a slow loop
+
+enum class Sensor {
+    CLEAR, // pulsing, line high between pulses
+    OBSTRUCTED, // line high, no pulses
+    ASLEEP, // line low, no pulses
+};
+
+struct Sim {
+    explicit Sim(bool counter)
+        : counter(counter)
+    {
+    }
+
+    // runs the sensor for `duration` us, the detector reads it every loop
+    ObstructionState run(Sensor sensor, uint32_t duration)
+    {
+        auto end = host_micros + duration;
+        while (host_micros != end) {
+            host_micros += 1000;
+            if (sensor == Sensor::CLEAR && host_micros % PULSE_PERIOD == 0) {
+                this->edge();
+            }
+            if (host_micros - this->last_loop >= LOOP_PERIOD) {
+                this->last_loop = host_micros;
+                this->state = this->detector.update(this->take(), sensor != Sensor::ASLEEP, host_micros);
+            }
+        }
+        return this->state;
+    }
+
+    void edge()
+    {
+        if (this->counter) {
+            this->count++;
+        } else {
+            ObstructionStore::isr(&this->store);
+        }
+    }
+
+    ObstructionPulses take()
+    {
+        if (!this->counter) {
+            return this->store.take();
+        }
+        // what PcntObstructionInput::take() reports: a count, stamped now
+        ObstructionPulses pulses;
+        pulses.count = this->count;
+        if (this->count != 0) {
+            pulses.last_edge = host_micros;
+        }
+        this->count = 0;
+        return pulses;
+    }
+
+    bool counter;
+    ObstructionStore store {};
+    uint32_t count { 0 };
+    ObstructionDetector detector;
+    ObstructionState state { ObstructionState::UNKNOWN };
+    uint32_t last_loop { 0 };
+};
+
+static void test_clear_and_obstructed(bool counter)
+{
+    host_micros = 1000000;
+    Sim sim(counter);
+    CHECK(sim.run(Sensor::CLEAR, 100000) == ObstructionState::CLEAR);
+    // a beam break shows once the next pulse is overdue, well within 100ms
+    CHECK(sim.run(Sensor::OBSTRUCTED, 60000) == ObstructionState::OBSTRUCTED);
+    CHECK(sim.run(Sensor::CLEAR, 100000) == ObstructionState::CLEAR);
+}
+
+static void test_asleep()
+{
+    host_micros = 1000000;
+    Sim sim(false);
+    CHECK(sim.run(Sensor::CLEAR, 100000) == ObstructionState::CLEAR);
+    // the sensor falling asleep is not an obstruction
+    CHECK(sim.run(Sensor::ASLEEP, 5000000) == ObstructionState::CLEAR);
+}
+
+static void test_wake_guard()
+{
+    host_micros = 1000000;
+    Sim sim(false);
+    CHECK(sim.run(Sensor::CLEAR, 100000) == ObstructionState::CLEAR);
+    CHECK(sim.run(Sensor::ASLEEP, 1000000) == ObstructionState::CLEAR);
+    // waking up the line is high without pulses for a while
+    CHECK(sim.run(Sensor::OBSTRUCTED, 500000) == ObstructionState::CLEAR);
+    CHECK(sim.run(Sensor::CLEAR, 100000) == ObstructionState::CLEAR);
+
+    // but staying high past the guard is an obstruction
+    CHECK(sim.run(Sensor::ASLEEP, 1000000) == ObstructionState::CLEAR);
+    CHECK(sim.run(Sensor::OBSTRUCTED, 800000) == ObstructionState::OBSTRUCTED);
+}
+
+static void test_stats(bool counter)
+{
+    host_micros = 1000000;
+    Sim sim(counter);
+    ObstructionStats stats {};
+    bool published = false;
+    for (int i = 0; i < 40 && !published; i++) {
+        sim.run(Sensor::CLEAR, 100000);
+        published = sim.detector.take_stats(stats);
+    }
+    CHECK(published);
+    // period in ms, whichever way it was counted
+    CHECK(std::fabs(stats.period - PULSE_PERIOD / 1000.0f) < 0.5f);
+    if (counter) {
+        // a bare count has no intervals to take a spread from
+        CHECK(std::isnan(stats.jitter));
+    } else {
+        CHECK(!std::isnan(stats.jitter));
+        CHECK(stats.jitter < 0.5f);
+    }
+}
+
+int main()
+{
+    test_clear_and_obstructed(false);
+    test_clear_and_obstructed(true);
+    test_asleep();
+    test_wake_guard();
+    test_stats(false);
+    test_stats(true);
+    if (failures != 0) {
+        std::fprintf(stderr, "%d failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("all passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+// Runs RATGDOComponent with Security+ 1.0 against a simulated opener, with
+// and without a wall panel, through the same SoftwareSerial reads and writes
+// as on the device.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "secplus1_sim.h"
+
+using namespace sim;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+static DoorState last_state(const Secplus1Sim& s)
+{
+    return s.notified.empty() ? DoorState::UNKNOWN : s.notified.back().state;
+}
+
+static bool notified(const Secplus1Sim& s, DoorState state)
+{
+    return std::any_of(s.notified.begin(), s.notified.end(), [state](const Notified& n) { return n.state == state; });
+}
+
+static void test_wall_panel()
+{
+    host_preferences.clear();
+    Secplus1Sim s(true);
+    s.run(5000);
+    CHECK(last_state(s) == DoorState::CLOSED);
+    // the panel does the polling, we only listen
+    CHECK(s.written_count() == 0);
+
+    // a remote opens the door
+    s.remote_press();
+    s.run(3000);
+    CHECK(last_state(s) == DoorState::OPENING);
+    s.run(10000);
+    CHECK(last_state(s) == DoorState::OPEN);
+    CHECK(s.written_count() == 0);
+}
+
+static void test_emulation()
+{
+    host_preferences.clear();
+    Secplus1Sim s(false);
+    s.run(10000);
+    // nobody polls, so we do, and read our own polls back with the answers
+    auto written = s.written();
+    CHECK(std::count(written.begin(), written.end(), 0x38) >= 2);
+    CHECK(last_state(s) == DoorState::CLOSED);
+
+    // our own echoes never look like a panel, the polls keep coming
+    auto polled = s.written_count();
+    s.run(10000);
+    written = s.written(polled);
+    CHECK(std::count(written.begin(), written.end(), 0x38) >= 10);
+
+    s.remote_press();
+    s.run(3000);
+    CHECK(last_state(s) == DoorState::OPENING);
+}
+
+static void test_door_open()
+{
+    host_preferences.clear();
+    Secplus1Sim s(true);
+    s.run(5000);
+    CHECK(last_state(s) == DoorState::CLOSED);
+
+    auto before = s.written_count();
+    s.ratgdo.door_open();
+    s.run(2000);
+    // press, a status query and the release
+    auto written = s.written(before);
+    auto press = std::find(written.begin(), written.end(), 0x30);
+    CHECK(press != written.end());
+    CHECK(std::find(press, written.end(), 0x31) != written.end());
+    CHECK(s.status() == STATUS_OPENING);
+    s.run(2000);
+    CHECK(last_state(s) == DoorState::OPENING);
+    s.run(10000);
+    CHECK(last_state(s) == DoorState::OPEN);
+
+    // already open, nothing to send
+    before = s.written_count();
+    s.ratgdo.door_open();
+    s.run(2000);
+    CHECK(s.written_count() == before);
+
+    s.ratgdo.door_close();
+    s.run(3000);
+    CHECK(notified(s, DoorState::CLOSING));
+    s.run(10000);
+    CHECK(last_state(s) == DoorState::CLOSED);
+}
+
+int main()
+{
+    test_wall_panel();
+    test_emulation();
+    test_door_open();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("all passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,166 @@
+// Feeds Sec+1 door status traffic through the confirmation filter the way
+// Secplus1::handle_command does, and compares it against the old rule of
+// waiting for every state to repeat.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "secplus1_state.h"
+
+using namespace esphome::ratgdo;
+using namespace esphome::ratgdo::secplus1;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                      \
+        }                                                                    \
+    } while (0)
+
+// A 0x38 poll and the opener's answer, as read off the bus
+struct Frame {
+    uint32_t at; // ms
+    uint8_t req;
+    uint8_t resp;
+};
+
+// Our toggle press, answered by the first change after it
+struct Toggle {
+    uint32_t at;
+};
+
+struct Confirmed {
+    uint32_t at;
+    DoorState state;
+};
+
+// What the opener said and when, written in the bus format: a wall panel
+// polls every 250ms. It opens the door for our toggle, carries one bad
+// answer mid travel, and closes for somebody else's remote.
+static const Frame TRAFFIC[] = {
+    { 0, 0x38, 0x05 }, // closed
+    { 250, 0x38, 0x05 },
+    { 500, 0x38, 0x05 },
+    // our toggle at 600
+    { 750, 0x38, 0x01 }, // opening
+    { 1000, 0x38, 0x01 },
+    { 1250, 0x38, 0x04 }, // bad answer, closing
+    { 1500, 0x38, 0x01 },
+    { 1750, 0x38, 0x01 },
+    { 2000, 0x38, 0x02 }, // open
+    { 2250, 0x38, 0x02 },
+    { 2500, 0x38, 0x02 },
+    { 5000, 0x38, 0x04 }, // closing, a remote we didn't see
+    { 5250, 0x38, 0x04 },
+    { 5500, 0x38, 0x04 },
+    { 7000, 0x38, 0x05 }, // closed
+    { 7250, 0x38, 0x05 },
+};
+static const Toggle TOGGLES[] = { { 600 } };
+
+// the door path of Secplus1::handle_command, without the side effects
+static std::vector<Confirmed> run(bool use_expected)
+{
+    std::vector<Confirmed> confirmed;
+    StateCandidate<DoorState> candidate { DoorState::UNKNOWN };
+    DoorState door_state = DoorState::UNKNOWN;
+    uint32_t toggled_at = 0;
+    size_t toggle = 0;
+
+    for (const auto& frame : TRAFFIC) {
+        while (toggle < sizeof(TOGGLES) / sizeof(TOGGLES[0]) && TOGGLES[toggle].at <= frame.at) {
+            toggled_at = TOGGLES[toggle++].at;
+        }
+        if (frame.req != 0x38) {
+            continue;
+        }
+        auto state = decode_door_status(frame.resp);
+        bool toggled = toggled_at != 0 && frame.at - toggled_at < TOGGLE_RESPONSE_WINDOW;
+        bool expected = use_expected && expected_door_transition(door_state, state, toggled);
+        if (!candidate.confirm(state, frame.at, expected)) {
+            continue;
+        }
+        if (state != door_state) {
+            toggled_at = 0;
+            confirmed.push_back({ frame.at, state });
+        }
+        door_state = state;
+    }
+    return confirmed;
+}
+
+static void test_decode()
+{
+    CHECK(decode_door_status(0x00) == DoorState::STOPPED);
+    CHECK(decode_door_status(0x01) == DoorState::OPENING);
+    CHECK(decode_door_status(0x02) == DoorState::OPEN);
+    CHECK(decode_door_status(0x04) == DoorState::CLOSING);
+    CHECK(decode_door_status(0x05) == DoorState::CLOSED);
+    CHECK(decode_door_status(0x06) == DoorState::STOPPED);
+    CHECK(decode_door_status(0x03) == DoorState::UNKNOWN);
+    // only the low 3 bits are the door
+    CHECK(decode_door_status(0xF2) == DoorState::OPEN);
+}
+
+static void test_expected_transitions()
+{
+    // limits are reached without our help
+    CHECK(expected_door_transition(DoorState::OPENING, DoorState::OPEN, false));
+    CHECK(expected_door_transition(DoorState::CLOSING, DoorState::CLOSED, false));
+    // starting to move is only expected after our toggle
+    CHECK(!expected_door_transition(DoorState::CLOSED, DoorState::OPENING, false));
+    CHECK(expected_door_transition(DoorState::CLOSED, DoorState::OPENING, true));
+    CHECK(!expected_door_transition(DoorState::CLOSED, DoorState::CLOSING, true));
+    CHECK(!expected_door_transition(DoorState::UNKNOWN, DoorState::OPEN, true));
+}
+
+static void test_traffic()
+{
+    auto confirmed = run(true);
+    // no bad answer gets through, every real change does
+    const Confirmed want[] = {
+        { 250, DoorState::CLOSED },
+        { 750, DoorState::OPENING },
+        { 2000, DoorState::OPEN },
+        { 5250, DoorState::CLOSING },
+        { 7000, DoorState::CLOSED },
+    };
+    CHECK(confirmed.size() == sizeof(want) / sizeof(want[0]));
+    for (size_t i = 0; i < confirmed.size() && i < sizeof(want) / sizeof(want[0]); i++) {
+        CHECK(confirmed[i].at == want[i].at);
+        CHECK(confirmed[i].state == want[i].state);
+    }
+
+    // the old rule sees the same states, each one poll later where we expected it
+    auto repeated = run(false);
+    CHECK(repeated.size() == confirmed.size());
+    uint32_t latency = 0;
+    uint32_t repeated_latency = 0;
+    for (size_t i = 0; i < confirmed.size() && i < repeated.size(); i++) {
+        CHECK(repeated[i].state == confirmed[i].state);
+        CHECK(repeated[i].at >= confirmed[i].at);
+        latency += confirmed[i].at;
+        repeated_latency += repeated[i].at;
+    }
+    CHECK(latency < repeated_latency);
+    std::printf("door changes confirmed %" PRIu32 "ms sooner in total over %zu changes\n",
+        repeated_latency - latency, confirmed.size());
+}
+
+int main()
+{
+    test_decode();
+    test_expected_transitions();
+    test_traffic();
+    if (failures != 0) {
+        std::fprintf(stderr, "%d failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    std::printf("all passed\n");
+    return EXIT_SUCCESS;
+}